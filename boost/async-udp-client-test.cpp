@@ -0,0 +1,306 @@
+#include "async-udp-client.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Firing = std::pair<std::uint64_t, TimerWheel::Tick>;
+
+class TimerWheelTest : public testing::Test
+{
+protected:
+  // advance() collecting what fired
+  std::vector<Firing> advanceTo(TimerWheel::Tick target)
+  {
+    std::vector<Firing> fired;
+    wheel.advance(target, [&](std::uint64_t sequence, TimerWheel::Tick tick) { fired.emplace_back(sequence, tick); });
+    return fired;
+  }
+
+  TimerWheel wheel{4};
+};
+
+TEST_F(TimerWheelTest, FiresAtScheduledTick)
+{
+  EXPECT_EQ(wheel.schedule(7, 3), 3);
+  EXPECT_TRUE(advanceTo(2).empty());
+  EXPECT_EQ(advanceTo(3), (std::vector<Firing>{{7, 3}}));
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST_F(TimerWheelTest, ZeroTicksMeansNextTick)
+{
+  EXPECT_EQ(wheel.schedule(1, 0), 1);
+  EXPECT_EQ(advanceTo(1), (std::vector<Firing>{{1, 1}}));
+}
+
+TEST_F(TimerWheelTest, EntriesBeyondOneRevolutionWaitForTheirTick)
+{
+  // 4 slots: tick 10 shares its slot with ticks 2 and 6
+  wheel.schedule(1, 2);
+  wheel.schedule(2, 10);
+  EXPECT_EQ(advanceTo(2), (std::vector<Firing>{{1, 2}}));
+  EXPECT_TRUE(advanceTo(9).empty());
+  EXPECT_EQ(wheel.size(), 1);
+  EXPECT_EQ(advanceTo(10), (std::vector<Firing>{{2, 10}}));
+}
+
+TEST_F(TimerWheelTest, RescheduledEntriesAlsoFireTheirStaleTicks)
+{
+  // there is no cancel: the owner tells the firings apart by tick
+  auto stale = wheel.schedule(5, 2);
+  auto current = wheel.schedule(5, 3);
+  EXPECT_EQ(advanceTo(3), (std::vector<Firing>{{5, stale}, {5, current}}));
+}
+
+TEST_F(TimerWheelTest, IdleWheelJumpsToTarget)
+{
+  EXPECT_TRUE(advanceTo(1000000).empty());
+  EXPECT_EQ(wheel.now(), 1000000);
+  EXPECT_EQ(wheel.schedule(1, 1), 1000001);
+}
+
+TEST_F(TimerWheelTest, FireMayScheduleAgain)
+{
+  // like a retransmit re-arming from inside the firing
+  wheel.schedule(1, 1);
+  std::vector<TimerWheel::Tick> ticks;
+  wheel.advance(5, [&](std::uint64_t sequence, TimerWheel::Tick tick)
+                {
+                  ticks.push_back(tick);
+                  wheel.schedule(sequence, 1);
+                });
+  EXPECT_EQ(ticks, (std::vector<TimerWheel::Tick>{1, 2, 3, 4, 5}));
+  EXPECT_EQ(wheel.size(), 1);
+}
+
+TEST_F(TimerWheelTest, FireMayAdvanceAnEmptyWheel)
+{
+  // AsyncUdpClient::arm() jumps an empty wheel to the present, also from within expire()
+  wheel.schedule(1, 1);
+  std::vector<Firing> fired;
+  wheel.advance(3, [&](std::uint64_t sequence, TimerWheel::Tick tick)
+                {
+                  fired.emplace_back(sequence, tick);
+                  EXPECT_EQ(wheel.size(), 0);
+                  wheel.advance(tick + 5, [&](std::uint64_t, TimerWheel::Tick) { ADD_FAILURE(); });
+                  wheel.schedule(sequence, 1);
+                });
+  EXPECT_EQ(fired, (std::vector<Firing>{{1, 1}}));
+  EXPECT_EQ(wheel.now(), 6);
+  EXPECT_EQ(advanceTo(7), (std::vector<Firing>{{1, 7}}));
+}
+
+TEST(TimerWheelSizeTest, OversizedWheelThrows)
+{
+  EXPECT_THROW(TimerWheel{SIZE_MAX}, std::length_error);
+}
+
+TEST(AsyncUdpClientTest, IgnoresRepliesFromOtherSources)
+{
+  using boost::asio::ip::udp;
+  boost::asio::io_service io_service;
+  udp::socket server(io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  udp::socket spoofer(io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+  AsyncUdpClient::Options options;
+  options.timeout = std::chrono::milliseconds(5000);
+  options.retransmitAfter = std::chrono::milliseconds(5000);
+  AsyncUdpClient client(io_service, server.local_endpoint(), options);
+  auto reply = client.call("ping");
+  // sends the request
+  io_service.poll();
+
+  std::array<char, 64> request;
+  udp::endpoint clientEndpoint;
+  auto length = server.receive_from(boost::asio::buffer(request), clientEndpoint);
+  ASSERT_EQ(length, AsyncUdpClient::kHeaderSize + 4);
+
+  // same sequence number, wrong source
+  std::string forged(request.data(), AsyncUdpClient::kHeaderSize);
+  spoofer.send_to(boost::asio::buffer(forged + "forged"), clientEndpoint);
+  std::string genuine(request.data(), AsyncUdpClient::kHeaderSize);
+  server.send_to(boost::asio::buffer(genuine + "pong"), clientEndpoint);
+
+  // both datagrams are already queued on the client socket
+  while (reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+  {
+    io_service.run_one();
+  }
+  EXPECT_EQ(reply.get(), "pong");
+  client.close();
+}
+
+TEST(AsyncUdpClientTest, RetransmitTimeoutFollowsMeasuredRoundTrip)
+{
+  using boost::asio::ip::udp;
+  boost::asio::io_service io_service;
+  udp::socket server(io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+  AsyncUdpClient::Options options;
+  options.timeout = std::chrono::milliseconds(5000);
+  options.retransmitAfter = std::chrono::milliseconds(1000);
+  options.minRetransmitAfter = std::chrono::milliseconds(1);
+  AsyncUdpClient client(io_service, server.local_endpoint(), options);
+  EXPECT_EQ(client.retransmitTimeout(), std::chrono::milliseconds(1000));
+
+  auto reply = client.call("ping");
+  io_service.poll();
+  std::array<char, 64> request;
+  udp::endpoint clientEndpoint;
+  auto length = server.receive_from(boost::asio::buffer(request), clientEndpoint);
+  // a slow server: the first sample sets the RTO to SRTT + 4 * SRTT / 2
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  server.send_to(boost::asio::buffer(request.data(), length), clientEndpoint);
+  while (reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+  {
+    io_service.run_one();
+  }
+  EXPECT_EQ(reply.get(), "ping");
+  EXPECT_EQ(client.retransmits(), 0);
+  EXPECT_GE(client.retransmitTimeout(), std::chrono::milliseconds(60));
+  EXPECT_LT(client.retransmitTimeout(), std::chrono::milliseconds(1000));
+  client.close();
+}
+
+// A loopback "server" socket that the test answers by hand, one datagram at a time.
+class AsyncUdpClientLoopbackTest : public testing::Test
+{
+protected:
+  using udp = boost::asio::ip::udp;
+
+  AsyncUdpClientLoopbackTest()
+  {
+    options.timeout = std::chrono::milliseconds(5000);
+    options.retransmitAfter = std::chrono::milliseconds(5000);
+  }
+
+  AsyncUdpClient &client()
+  {
+    if (!_client)
+    {
+      _client = std::make_unique<AsyncUdpClient>(io_service, server.local_endpoint(), options);
+    }
+    return *_client;
+  }
+
+  // Runs the client until the server socket has a request queued, then returns it whole.
+  std::string receiveRequest()
+  {
+    for (int i = 0; i < 1000 && server.available() == 0; ++i)
+    {
+      io_service.run_one_for(std::chrono::milliseconds(1));
+    }
+    std::array<char, 64> request;
+    auto length = server.receive_from(boost::asio::buffer(request), _clientEndpoint);
+    return std::string(request.data(), length);
+  }
+
+  void reply(const std::string &request, const std::string &payload)
+  {
+    server.send_to(boost::asio::buffer(request.substr(0, AsyncUdpClient::kHeaderSize) + payload), _clientEndpoint);
+  }
+
+  boost::system::error_code errorOf(std::future<std::string> &reply)
+  {
+    runUntilReady(reply);
+    try
+    {
+      reply.get();
+    }
+    catch (const boost::system::system_error &error)
+    {
+      return error.code();
+    }
+    return boost::system::error_code();
+  }
+
+  void runUntilReady(std::future<std::string> &reply)
+  {
+    while (reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      io_service.run_one();
+    }
+  }
+
+  boost::asio::io_service io_service;
+  udp::socket server{io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0)};
+  AsyncUdpClient::Options options;
+
+private:
+  udp::endpoint _clientEndpoint;
+  std::unique_ptr<AsyncUdpClient> _client;
+};
+
+TEST_F(AsyncUdpClientLoopbackTest, OutOfOrderRepliesReachTheirCalls)
+{
+  auto first = client().call("first");
+  auto second = client().call("second");
+  auto third = client().call("third");
+  io_service.poll();
+  std::vector<std::string> requests;
+  for (int i = 0; i < 3; ++i)
+  {
+    requests.push_back(receiveRequest());
+  }
+  for (auto it = requests.rbegin(); it != requests.rend(); ++it)
+  {
+    reply(*it, "re:" + it->substr(AsyncUdpClient::kHeaderSize));
+  }
+  runUntilReady(first);
+  runUntilReady(second);
+  runUntilReady(third);
+  EXPECT_EQ(first.get(), "re:first");
+  EXPECT_EQ(second.get(), "re:second");
+  EXPECT_EQ(third.get(), "re:third");
+  EXPECT_EQ(client().inFlight(), 0);
+}
+
+TEST_F(AsyncUdpClientLoopbackTest, LostRequestIsRetransmitted)
+{
+  options.retransmitAfter = std::chrono::milliseconds(20);
+  auto response = client().call("ping");
+  // the first transmission goes missing
+  auto dropped = receiveRequest();
+  auto retransmitted = receiveRequest();
+  EXPECT_EQ(retransmitted, dropped);
+  reply(retransmitted, "pong");
+  runUntilReady(response);
+  EXPECT_EQ(response.get(), "pong");
+  EXPECT_EQ(client().retransmits(), 1);
+  EXPECT_EQ(client().timeouts(), 0);
+}
+
+TEST_F(AsyncUdpClientLoopbackTest, SilentServerTimesOutAfterAllRetransmits)
+{
+  options.timeout = std::chrono::milliseconds(200);
+  options.retransmitAfter = std::chrono::milliseconds(10);
+  options.maxRetransmits = 3;
+  auto response = client().call("ping");
+  EXPECT_EQ(errorOf(response), boost::asio::error::timed_out);
+  EXPECT_EQ(client().retransmits(), options.maxRetransmits);
+  EXPECT_EQ(client().timeouts(), 1);
+  EXPECT_EQ(client().inFlight(), 0);
+
+  std::size_t received = 0;
+  while (server.available() > 0)
+  {
+    receiveRequest();
+    ++received;
+  }
+  EXPECT_EQ(received, 1 + options.maxRetransmits);
+}
+
+TEST_F(AsyncUdpClientLoopbackTest, CloseAbortsPendingCalls)
+{
+  auto first = client().call("first");
+  auto second = client().call("second");
+  io_service.poll();
+  EXPECT_EQ(client().inFlight(), 2);
+  client().close();
+  EXPECT_EQ(errorOf(first), boost::asio::error::operation_aborted);
+  EXPECT_EQ(errorOf(second), boost::asio::error::operation_aborted);
+  EXPECT_EQ(client().inFlight(), 0);
+}
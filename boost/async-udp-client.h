@@ -0,0 +1,500 @@
+#ifndef ASYNCUDPCLIENT_H
+#define ASYNCUDPCLIENT_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "../lockfree/pow2.h"
+
+// Hashed timing wheel keyed by request sequence number. Scheduling and firing are
+// O(1); entries further out than one revolution simply stay in their slot until
+// the wheel comes round to their tick. There is no cancel: owners ignore stale
+// firings instead, which is cheaper than removing entries.
+class TimerWheel
+{
+public:
+  using Tick = std::uint64_t;
+
+  explicit TimerWheel(std::size_t slots = 1024) : _slots(round_up_pow2(slots)), _mask(_slots.size() - 1) {}
+
+  Tick now() const
+  {
+    return _current;
+  }
+
+  // Arms sequence to fire `ticks` (at least 1) after the current tick; returns the tick it fires at.
+  Tick schedule(std::uint64_t sequence, Tick ticks)
+  {
+    Tick expiry = _current + (ticks == 0 ? 1 : ticks);
+    _slots[expiry & _mask].push_back(Entry{sequence, expiry});
+    ++_size;
+    return expiry;
+  }
+
+  // Moves the wheel forward to `target`, calling fire(sequence, tick) for every entry that expires.
+  template <typename Fire>
+  void advance(Tick target, Fire &&fire)
+  {
+    while (_current < target && _size > 0)
+    {
+      ++_current;
+      auto &slot = _slots[_current & _mask];
+      if (slot.empty())
+      {
+        continue;
+      }
+      // fire() may schedule new entries, so collect the expired ones before calling it
+      std::vector<Entry> expired;
+      expired.swap(_expired);
+      expired.clear();
+      std::size_t kept = 0;
+      for (auto &entry : slot)
+      {
+        if (entry.expiry == _current)
+        {
+          expired.push_back(entry);
+        }
+        else
+        {
+          slot[kept++] = entry;
+        }
+      }
+      slot.resize(kept);
+      _size -= expired.size();
+      for (auto &entry : expired)
+      {
+        fire(entry.sequence, entry.expiry);
+      }
+      // keep the capacity for the next tick
+      _expired.swap(expired);
+    }
+    if (_current < target)
+    {
+      _current = target;
+    }
+  }
+
+  std::size_t size() const
+  {
+    return _size;
+  }
+
+private:
+  struct Entry
+  {
+    std::uint64_t sequence;
+    Tick expiry;
+  };
+
+  std::vector<std::vector<Entry>> _slots;
+  std::size_t _mask;
+  std::vector<Entry> _expired;
+  Tick _current = 0;
+  std::size_t _size = 0;
+};
+
+// Many outstanding request/reply exchanges over one UDP socket.
+//
+// Every datagram starts with an 8-byte sequence number that the server has to
+// copy into its reply (EchoHandler does); replies are matched on it, so they may
+// arrive in any order. Unanswered requests are retransmitted with exponential
+// backoff until their overall timeout, when the callback gets timed_out.
+//
+// The first retransmit waits one retransmission timeout (RTO), derived from the
+// smoothed round-trip time and its variance as in RFC 6298. Only replies to
+// requests that were never retransmitted are sampled (Karn's rule), so an
+// ambiguous reply cannot drag the estimate down. The RTO never drops below
+// minRetransmitAfter (scheduling stalls dwarf a loopback round trip) and stays
+// short enough for every retransmit to go out before the timeout.
+//
+// Retransmits are paced: at most maxRetransmitsPerTick go out per timer tick and
+// a full socket buffer ends the tick early. The rest wait in line for the next
+// ticks instead of every overdue request firing at once.
+//
+// All state lives on the io_service thread: asyncCall() and call() may be used
+// from anywhere, but the io_service must be run by a single thread.
+class AsyncUdpClient
+{
+public:
+  using Callback = std::function<void(const boost::system::error_code &, std::string reply)>;
+  static constexpr std::size_t kHeaderSize = sizeof(std::uint64_t);
+
+  struct Options
+  {
+    std::chrono::milliseconds timeout{1000};           // per request, across all retransmits
+    std::chrono::milliseconds retransmitAfter{50};     // RTO until the first round trip is measured
+    std::chrono::milliseconds minRetransmitAfter{50};  // lower bound of the measured RTO
+    double backoff = 2.0;                              // growth factor of the retransmit delay
+    unsigned maxRetransmits = 4;
+    unsigned maxRetransmitsPerTick = 16;               // beyond that they queue for the next tick
+    std::chrono::microseconds tick{1000};              // timer wheel resolution
+  };
+
+  AsyncUdpClient(boost::asio::io_service &io_service, const boost::asio::ip::udp::endpoint &server)
+      : AsyncUdpClient(io_service, server, Options())
+  {
+  }
+
+  AsyncUdpClient(boost::asio::io_service &io_service, const boost::asio::ip::udp::endpoint &server,
+                 Options options)
+      : _socket(io_service), _server(server), _options(options), _timer(io_service), _epoch(Clock::now()),
+        _nextSequence(randomSequence()), _rto(options.retransmitAfter)
+  {
+    _socket.open(server.protocol());
+    // a full socket buffer is treated like a lost datagram and left to retransmission
+    _socket.non_blocking(true);
+    startReceive();
+  }
+
+  AsyncUdpClient(const AsyncUdpClient &) = delete;
+  AsyncUdpClient &operator=(const AsyncUdpClient &) = delete;
+
+  void asyncCall(std::string payload, Callback callback)
+  {
+    boost::asio::dispatch(_socket.get_executor(),
+                          [this, payload = std::move(payload), callback = std::move(callback)]() mutable
+                          { start(std::move(payload), std::move(callback)); });
+  }
+
+  std::future<std::string> call(std::string payload)
+  {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    auto future = promise->get_future();
+    asyncCall(std::move(payload), [promise](const boost::system::error_code &ec, std::string reply)
+              {
+                if (ec)
+                {
+                  promise->set_exception(std::make_exception_ptr(boost::system::system_error(ec)));
+                }
+                else
+                {
+                  promise->set_value(std::move(reply));
+                }
+              });
+    return future;
+  }
+
+  // Fails every outstanding request with operation_aborted and closes the socket.
+  void close()
+  {
+    boost::asio::dispatch(_socket.get_executor(), [this]()
+                          {
+                            boost::system::error_code ignored;
+                            _socket.close(ignored);
+                            _timer.cancel(ignored);
+                            auto pending = std::move(_pending);
+                            _pending.clear();
+                            _deferred.clear();
+                            for (auto &entry : pending)
+                            {
+                              entry.second.callback(boost::asio::error::operation_aborted, std::string());
+                            }
+                          });
+  }
+
+  // The counters below are only meaningful when read from the io_service thread
+  // or after it has stopped.
+  std::size_t inFlight() const
+  {
+    return _pending.size();
+  }
+
+  std::uint64_t retransmits() const
+  {
+    return _retransmits;
+  }
+
+  std::uint64_t timeouts() const
+  {
+    return _timeouts;
+  }
+
+  // datagrams the socket refused, e.g. with would_block; they count as lost
+  std::uint64_t sendFailures() const
+  {
+    return _sendFailures;
+  }
+
+  std::chrono::microseconds retransmitTimeout() const
+  {
+    return _rto;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Pending
+  {
+    std::string datagram;
+    Callback callback;
+    Clock::time_point sentAt;
+    Clock::time_point deadline;
+    std::chrono::microseconds retransmitAfter;
+    unsigned retransmits;
+    TimerWheel::Tick armedAt;  // firings for any other tick are stale
+    bool deferred = false;     // waiting in _deferred for a retransmit slot
+  };
+
+  // Sequence numbers start at a random point, so an off-path sender cannot
+  // guess the ones in flight.
+  static std::uint64_t randomSequence()
+  {
+    std::random_device random;
+    return (static_cast<std::uint64_t>(random()) << 32) ^ random();
+  }
+
+  void start(std::string payload, Callback callback)
+  {
+    auto sequence = _nextSequence++;
+    std::string datagram(kHeaderSize + payload.size(), '\0');
+    std::memcpy(&datagram[0], &sequence, kHeaderSize);
+    std::memcpy(&datagram[kHeaderSize], payload.data(), payload.size());
+
+    auto now = Clock::now();
+    auto &pending = _pending[sequence];
+    pending = Pending{std::move(datagram), std::move(callback), now, now + _options.timeout, _rto, 0, 0};
+    transmit(pending);
+    arm(sequence, pending, now, now + pending.retransmitAfter);
+  }
+
+  boost::system::error_code transmit(const Pending &pending)
+  {
+    boost::system::error_code error;
+    _socket.send_to(boost::asio::buffer(pending.datagram), _server, 0, error);
+    if (error)
+    {
+      ++_sendFailures;
+    }
+    return error;
+  }
+
+  // Schedules the next retransmit at fireAt, or the final timeout if that comes first.
+  void arm(std::uint64_t sequence, Pending &pending, Clock::time_point now, Clock::time_point fireAt)
+  {
+    if (_wheel.size() == 0)
+    {
+      // nothing to fire, so jump an idle wheel to the present instead of stepping through every tick
+      _wheel.advance(currentTick(now), [](std::uint64_t, TimerWheel::Tick) {});
+    }
+    fireAt = std::min(fireAt, pending.deadline);
+    auto fireTick = currentTick(fireAt) + 1;
+    // the wheel may lag behind the clock between timer callbacks, so count from where it stands
+    auto ticks = fireTick > _wheel.now() ? fireTick - _wheel.now() : 1;
+    pending.armedAt = _wheel.schedule(sequence, ticks);
+    startTimer();
+  }
+
+  TimerWheel::Tick currentTick(Clock::time_point when) const
+  {
+    return static_cast<TimerWheel::Tick>(
+            std::chrono::duration_cast<std::chrono::microseconds>(when - _epoch).count() / _options.tick.count());
+  }
+
+  void startTimer()
+  {
+    if (_timerRunning || _wheel.size() == 0)
+    {
+      return;
+    }
+    _timerRunning = true;
+    _timer.expires_at(_epoch + _options.tick * (_wheel.now() + 1));
+    _timer.async_wait([this](const boost::system::error_code &error)
+                      {
+                        _timerRunning = false;
+                        if (error)
+                        {
+                          return;
+                        }
+                        auto now = Clock::now();
+                        _retransmitBudget = _options.maxRetransmitsPerTick;
+                        // the oldest deferred retransmits go first
+                        retransmitDeferred(now);
+                        _wheel.advance(currentTick(now),
+                                       [this](std::uint64_t sequence, TimerWheel::Tick tick)
+                                       { expire(sequence, tick); });
+                        startTimer();
+                      });
+  }
+
+  void expire(std::uint64_t sequence, TimerWheel::Tick tick)
+  {
+    auto it = _pending.find(sequence);
+    if (it == _pending.end() || it->second.armedAt != tick)
+    {
+      return;
+    }
+    auto &pending = it->second;
+    auto now = Clock::now();
+    if (now >= pending.deadline || pending.retransmits >= _options.maxRetransmits)
+    {
+      if (now < pending.deadline)
+      {
+        // out of retransmits; wait out the rest of the timeout for a late reply
+        arm(sequence, pending, now, pending.deadline);
+        return;
+      }
+      ++_timeouts;
+      complete(it, boost::asio::error::timed_out, std::string());
+      return;
+    }
+    if (_retransmitBudget == 0)
+    {
+      defer(sequence, pending, now);
+      return;
+    }
+    retransmit(sequence, pending, now);
+  }
+
+  void retransmit(std::uint64_t sequence, Pending &pending, Clock::time_point now)
+  {
+    --_retransmitBudget;
+    if (transmit(pending) == boost::asio::error::would_block)
+    {
+      // the socket buffer is full, so the rest of this tick would fail as well
+      _retransmitBudget = 0;
+      defer(sequence, pending, now);
+      return;
+    }
+    ++pending.retransmits;
+    ++_retransmits;
+    pending.retransmitAfter = std::chrono::duration_cast<std::chrono::microseconds>(
+            pending.retransmitAfter * _options.backoff);
+    arm(sequence, pending, now, now + pending.retransmitAfter);
+  }
+
+  // Queues a retransmit for a later tick once this one has sent its share. Waiting
+  // in line costs nothing per tick; the request stays armed for its deadline.
+  void defer(std::uint64_t sequence, Pending &pending, Clock::time_point now)
+  {
+    pending.deferred = true;
+    _deferred.push_back(sequence);
+    arm(sequence, pending, now, pending.deadline);
+  }
+
+  void retransmitDeferred(Clock::time_point now)
+  {
+    while (_retransmitBudget > 0 && !_deferred.empty())
+    {
+      auto it = _pending.find(_deferred.front());
+      _deferred.pop_front();
+      // answered or timed out while waiting
+      if (it != _pending.end() && it->second.deferred)
+      {
+        it->second.deferred = false;
+        retransmit(it->first, it->second, now);
+      }
+    }
+  }
+
+  // RFC 6298 section 2, with the clock granularity G being one wheel tick.
+  void sampleRtt(std::chrono::microseconds rtt)
+  {
+    if (!_haveRtt)
+    {
+      _srtt = rtt;
+      _rttvar = rtt / 2;
+      _haveRtt = true;
+    }
+    else
+    {
+      auto delta = _srtt > rtt ? _srtt - rtt : rtt - _srtt;
+      _rttvar = (3 * _rttvar + delta) / 4;
+      _srtt = (7 * _srtt + rtt) / 8;
+    }
+    auto rto = _srtt + std::max<std::chrono::microseconds>(_options.tick, 4 * _rttvar);
+    _rto = std::min(std::max(rto, std::chrono::microseconds(_options.minRetransmitAfter)), maxRto());
+  }
+
+  // the largest RTO that still sends every retransmit before the timeout, so a
+  // slow estimate cannot cost a request its retransmits
+  std::chrono::microseconds maxRto() const
+  {
+    double schedule = 0;
+    double delay = 1;
+    for (unsigned i = 0; i < _options.maxRetransmits; ++i)
+    {
+      schedule += delay;
+      delay *= _options.backoff;
+    }
+    if (schedule == 0)
+    {
+      return _options.timeout;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(_options.timeout / schedule);
+  }
+
+  void complete(std::unordered_map<std::uint64_t, Pending>::iterator it, const boost::system::error_code &ec,
+                std::string reply)
+  {
+    auto callback = std::move(it->second.callback);
+    _pending.erase(it);
+    callback(ec, std::move(reply));
+  }
+
+  void startReceive()
+  {
+    _socket.async_receive_from(boost::asio::buffer(_recvBuffer), _replyEndpoint,
+                               [this](const boost::system::error_code &error, std::size_t bytes_transferred)
+                               { handleReceive(error, bytes_transferred); });
+  }
+
+  void handleReceive(const boost::system::error_code &error, std::size_t bytes_transferred)
+  {
+    if (error == boost::asio::error::operation_aborted)
+    {
+      return;
+    }
+    // only the server may answer; anything else reaching the socket is dropped
+    if (!error && bytes_transferred >= kHeaderSize && _replyEndpoint == _server)
+    {
+      std::uint64_t sequence;
+      std::memcpy(&sequence, _recvBuffer.data(), kHeaderSize);
+      auto it = _pending.find(sequence);
+      // duplicates of an already answered (retransmitted) request land here too
+      if (it != _pending.end())
+      {
+        if (it->second.retransmits == 0)
+        {
+          sampleRtt(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - it->second.sentAt));
+        }
+        complete(it, error, std::string(_recvBuffer.data() + kHeaderSize, bytes_transferred - kHeaderSize));
+      }
+    }
+    startReceive();
+  }
+
+  boost::asio::ip::udp::socket _socket;
+  boost::asio::ip::udp::endpoint _server;
+  boost::asio::ip::udp::endpoint _replyEndpoint;
+  Options _options;
+  boost::asio::steady_timer _timer;
+  Clock::time_point _epoch;
+  TimerWheel _wheel;
+  bool _timerRunning = false;
+  std::unordered_map<std::uint64_t, Pending> _pending;
+  std::uint64_t _nextSequence;
+  std::uint64_t _retransmits = 0;
+  std::uint64_t _timeouts = 0;
+  std::uint64_t _sendFailures = 0;
+  unsigned _retransmitBudget = 0;
+  std::deque<std::uint64_t> _deferred;
+  bool _haveRtt = false;
+  std::chrono::microseconds _srtt{0};
+  std::chrono::microseconds _rttvar{0};
+  std::chrono::microseconds _rto;
+  std::array<char, 65536> _recvBuffer;
+};
+
+#endif
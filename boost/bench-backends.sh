@@ -0,0 +1,32 @@
+#!/bin/sh
+# Loopback comparison of the udp-server backends: the same load generator runs
+# against the asio and the io_uring server, one after the other.
+# usage: bench-backends.sh [directory with udp-server and udp-client] [seconds per run]
+set -e
+
+BIN=${1:-build/release/boost}
+DURATION=${2:-5}
+PORT=${BENCH_PORT:-1111}
+SERVER_LOG=$(mktemp)
+trap 'rm -f "$SERVER_LOG"' EXIT
+
+for backend in asio uring "uring --uring-zerocopy"; do
+    echo "=== backend $backend"
+    # shellcheck disable=SC2086
+    "$BIN/udp-server" --port "$PORT" --backend $backend --echo 2>"$SERVER_LOG" &
+    SERVER_PID=$!
+    sleep 0.5
+
+    echo "--- closed loop, 8 sockets x 16 in flight"
+    "$BIN/udp-client" --load --port "$PORT" --concurrency 8 --window 16 --duration "$DURATION" | tail -n 5
+    echo "--- open loop, 100k pps"
+    "$BIN/udp-client" --load --port "$PORT" --concurrency 8 --rate 100000 --duration "$DURATION" | tail -n 5
+    echo "--- open loop, 100k pps, 1024 byte payload"
+    "$BIN/udp-client" --load --port "$PORT" --concurrency 8 --rate 100000 --size 1024 --duration "$DURATION" | tail -n 5
+
+    kill -INT $SERVER_PID
+    wait $SERVER_PID || true
+    echo "--- server"
+    # the fallback notice, if io_uring was unavailable, plus the server-side latency
+    grep -E "unavailable|not built|latency_inline" "$SERVER_LOG"
+done
@@ -0,0 +1,115 @@
+#include "latency-histogram.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+
+using Histogram = LatencyHistogram;
+
+TEST(LatencyHistogramTest, SmallValuesHaveBucketsOfTheirOwn)
+{
+  for (std::uint64_t value = 0; value < 2 * Histogram::kSubBuckets; ++value)
+  {
+    EXPECT_EQ(Histogram::bucketIndex(value), value);
+    EXPECT_EQ(Histogram::highestEquivalentValue(value), value);
+  }
+}
+
+TEST(LatencyHistogramTest, BucketsAreContiguous)
+{
+  // every bucket ends right before the next one starts
+  for (std::size_t index = 0; index + 1 < Histogram::kBuckets; ++index)
+  {
+    auto highest = Histogram::highestEquivalentValue(index);
+    ASSERT_EQ(Histogram::bucketIndex(highest), index);
+    ASSERT_EQ(Histogram::bucketIndex(highest + 1), index + 1);
+  }
+  EXPECT_EQ(Histogram::bucketIndex(UINT64_MAX), Histogram::kBuckets - 1);
+  EXPECT_EQ(Histogram::highestEquivalentValue(Histogram::kBuckets - 1), UINT64_MAX);
+}
+
+TEST(LatencyHistogramTest, RelativeErrorIsBounded)
+{
+  for (std::uint64_t value = 1; value < (std::uint64_t{1} << 62); value = value * 3 + 1)
+  {
+    auto highest = Histogram::highestEquivalentValue(Histogram::bucketIndex(value));
+    EXPECT_GE(highest, value);
+    EXPECT_LE(highest - value, value / Histogram::kSubBuckets);
+  }
+}
+
+TEST(LatencyHistogramTest, Percentiles)
+{
+  auto histogram = std::make_unique<Histogram>();
+  EXPECT_EQ(histogram->valueAtPercentile(50), 0);
+  for (std::uint64_t value = 1; value <= 100; ++value)
+  {
+    histogram->record(value);
+  }
+  EXPECT_EQ(histogram->count(), 100);
+  EXPECT_EQ(histogram->max(), 100);
+  EXPECT_DOUBLE_EQ(histogram->mean(), 50.5);
+  EXPECT_EQ(histogram->valueAtPercentile(0.1), 1);
+  EXPECT_EQ(histogram->valueAtPercentile(50), 50);
+  EXPECT_EQ(histogram->valueAtPercentile(99), 99);
+  EXPECT_EQ(histogram->valueAtPercentile(100), 100);
+}
+
+TEST(LatencyHistogramTest, PercentileIsCappedAtMax)
+{
+  // 1000000 shares a bucket with larger values, but none was recorded
+  auto histogram = std::make_unique<Histogram>();
+  histogram->record(1000000);
+  EXPECT_GT(Histogram::highestEquivalentValue(Histogram::bucketIndex(1000000)), 1000000);
+  EXPECT_EQ(histogram->valueAtPercentile(50), 1000000);
+}
+
+TEST(LatencyHistogramTest, RecordOwnedMatchesRecord)
+{
+  auto shared = std::make_unique<Histogram>();
+  auto owned = std::make_unique<Histogram>();
+  for (std::uint64_t value : {3, 70, 1000, 123456, 99999999})
+  {
+    shared->record(value);
+    owned->recordOwned(value);
+  }
+  EXPECT_EQ(owned->count(), shared->count());
+  EXPECT_EQ(owned->max(), shared->max());
+  EXPECT_DOUBLE_EQ(owned->mean(), shared->mean());
+  for (double percentile : {10.0, 50.0, 90.0, 100.0})
+  {
+    EXPECT_EQ(owned->valueAtPercentile(percentile), shared->valueAtPercentile(percentile));
+  }
+}
+
+TEST(LatencyHistogramTest, MergeAddsUp)
+{
+  auto low = std::make_unique<Histogram>();
+  auto high = std::make_unique<Histogram>();
+  for (int i = 0; i < 90; ++i)
+  {
+    low->recordOwned(10);
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    high->recordOwned(1000);
+  }
+  low->merge(*high);
+  EXPECT_EQ(low->count(), 100);
+  EXPECT_EQ(low->max(), 1000);
+  EXPECT_DOUBLE_EQ(low->mean(), 109.0);
+  EXPECT_EQ(low->valueAtPercentile(90), 10);
+  EXPECT_EQ(low->valueAtPercentile(91), 1000);
+  // the source is left alone
+  EXPECT_EQ(high->count(), 10);
+}
+
+TEST(LatencyHistogramTest, PrintsMicroseconds)
+{
+  auto histogram = std::make_unique<Histogram>();
+  histogram->record(1000);
+  histogram->record(3000);
+  std::ostringstream out;
+  histogram->print(out);
+  EXPECT_EQ(out.str(), "n=2 mean=2.0us p50=1.0us p99=3.0us p99.9=3.0us max=3.0us");
+}
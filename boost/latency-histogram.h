@@ -0,0 +1,150 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <iomanip>
+
+// HDR-style log-linear histogram of nanosecond latencies. Values below
+// 2 * kSubBuckets are counted exactly; above that every power of two is split
+// into kSubBuckets linear buckets, so any recorded value is reported with
+// under 1/kSubBuckets (~1.6%) relative error. record() is safe from any number
+// of threads; it takes three relaxed atomic adds plus a CAS loop for the max.
+class LatencyHistogram
+{
+public:
+  static constexpr unsigned kSubBucketBits = 6;
+  static constexpr std::uint64_t kSubBuckets = 1u << kSubBucketBits;
+  static constexpr std::size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  void record(std::uint64_t nanos)
+  {
+    _counts[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+    _total.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(nanos, std::memory_order_relaxed);
+    std::uint64_t seen = _max.load(std::memory_order_relaxed);
+    while (nanos > seen && !_max.compare_exchange_weak(seen, nanos, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  // record() for a histogram written by one thread only, like OwnedCounter:
+  // plain loads and stores, no locked instruction. Readers may run concurrently.
+  void recordOwned(std::uint64_t nanos)
+  {
+    bump(_counts[bucketIndex(nanos)], 1);
+    bump(_total, 1);
+    bump(_sum, nanos);
+    if (nanos > _max.load(std::memory_order_relaxed))
+    {
+      _max.store(nanos, std::memory_order_relaxed);
+    }
+  }
+
+  void merge(const LatencyHistogram &other)
+  {
+    for (std::size_t i = 0; i < kBuckets; ++i)
+    {
+      auto count = other._counts[i].load(std::memory_order_relaxed);
+      if (count != 0)
+      {
+        _counts[i].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+    _total.fetch_add(other.count(), std::memory_order_relaxed);
+    _sum.fetch_add(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    std::uint64_t otherMax = other.max();
+    std::uint64_t seen = _max.load(std::memory_order_relaxed);
+    while (otherMax > seen && !_max.compare_exchange_weak(seen, otherMax, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  std::uint64_t count() const
+  {
+    return _total.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t max() const
+  {
+    return _max.load(std::memory_order_relaxed);
+  }
+
+  double mean() const
+  {
+    auto total = count();
+    return total == 0 ? 0.0 : static_cast<double>(_sum.load(std::memory_order_relaxed)) / total;
+  }
+
+  // Highest value equivalent to the bucket holding the given percentile (0-100].
+  std::uint64_t valueAtPercentile(double percentile) const
+  {
+    auto total = count();
+    if (total == 0)
+    {
+      return 0;
+    }
+    auto target = static_cast<std::uint64_t>(percentile / 100.0 * total + 0.5);
+    if (target == 0)
+    {
+      target = 1;
+    }
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i)
+    {
+      seen += _counts[i].load(std::memory_order_relaxed);
+      if (seen >= target)
+      {
+        auto value = highestEquivalentValue(i);
+        return value < max() ? value : max();
+      }
+    }
+    return max();
+  }
+
+  // One line summary in microseconds, e.g. "n=1000 mean=12.1us p50=11.0us ...".
+  void print(std::ostream &out) const
+  {
+    auto micros = [](double nanos) { return nanos / 1000.0; };
+    out << std::fixed << std::setprecision(1) << "n=" << count() << " mean=" << micros(mean())
+        << "us p50=" << micros(valueAtPercentile(50.0)) << "us p99=" << micros(valueAtPercentile(99.0))
+        << "us p99.9=" << micros(valueAtPercentile(99.9)) << "us max=" << micros(max()) << "us";
+  }
+
+  static std::size_t bucketIndex(std::uint64_t value)
+  {
+    if (value < 2 * kSubBuckets)
+    {
+      return static_cast<std::size_t>(value);
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + static_cast<std::size_t>((value >> shift) - kSubBuckets);
+  }
+
+  static std::uint64_t highestEquivalentValue(std::size_t index)
+  {
+    if (index < 2 * kSubBuckets)
+    {
+      return index;
+    }
+    std::uint64_t shift = index / kSubBuckets - 1;
+    std::uint64_t lowest = (index % kSubBuckets + kSubBuckets) << shift;
+    return lowest + (std::uint64_t{1} << shift) - 1;
+  }
+
+private:
+  static void bump(std::atomic<std::uint64_t> &value, std::uint64_t amount)
+  {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<std::uint64_t>, kBuckets> _counts{};
+  std::atomic<std::uint64_t> _total{0};
+  std::atomic<std::uint64_t> _sum{0};
+  std::atomic<std::uint64_t> _max{0};
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "log-batch.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Record = std::pair<logbatch::RecordKind, std::string>;
+
+namespace
+{
+
+  bool parseAll(std::string_view datagram, std::uint64_t &sequence, std::vector<Record> &records)
+  {
+    return logbatch::parse(datagram, sequence, [&](logbatch::RecordKind kind, std::string_view record)
+                           { records.emplace_back(kind, std::string(record)); });
+  }
+
+} // namespace
+
+TEST(LogBatchTest, RoundTrip)
+{
+  logbatch::Writer writer{logbatch::kDefaultDatagramSize};
+  writer.reset(42);
+  writer.append(logbatch::RecordKind::Text, "hello");
+  writer.append(logbatch::RecordKind::Binary, std::string("\0\1\2", 3));
+  writer.append(logbatch::RecordKind::Text, "");
+  EXPECT_EQ(writer.count(), 3);
+
+  std::uint64_t sequence = 0;
+  std::vector<Record> records;
+  ASSERT_TRUE(parseAll(writer.data(), sequence, records));
+  EXPECT_EQ(sequence, 42);
+  EXPECT_EQ(records, (std::vector<Record>{{logbatch::RecordKind::Text, "hello"},
+                                          {logbatch::RecordKind::Binary, std::string("\0\1\2", 3)},
+                                          {logbatch::RecordKind::Text, ""}}));
+}
+
+TEST(LogBatchTest, EmptyBatch)
+{
+  logbatch::Writer writer{logbatch::kDefaultDatagramSize};
+  EXPECT_EQ(writer.data().size(), logbatch::kHeaderSize);
+  std::uint64_t sequence = 1;
+  std::vector<Record> records;
+  EXPECT_TRUE(parseAll(writer.data(), sequence, records));
+  EXPECT_EQ(sequence, 0);
+  EXPECT_TRUE(records.empty());
+}
+
+TEST(LogBatchTest, FitsRespectsDatagramSize)
+{
+  logbatch::Writer writer{64};
+  EXPECT_EQ(writer.maxRecordSize(), 64 - logbatch::kHeaderSize - logbatch::kRecordHeaderSize);
+  EXPECT_TRUE(writer.fits(writer.maxRecordSize()));
+  EXPECT_FALSE(writer.fits(writer.maxRecordSize() + 1));
+  writer.append(logbatch::RecordKind::Text, std::string(writer.maxRecordSize(), 'x'));
+  EXPECT_EQ(writer.data().size(), 64);
+  EXPECT_FALSE(writer.fits(0));
+}
+
+TEST(LogBatchTest, DatagramSizeIsValidated)
+{
+  EXPECT_THROW(logbatch::Writer{0}, std::invalid_argument);
+  EXPECT_THROW(logbatch::Writer{logbatch::kMinDatagramSize - 1}, std::invalid_argument);
+  EXPECT_THROW(logbatch::Writer{logbatch::kMaxDatagramSize + 1}, std::invalid_argument);
+
+  logbatch::Writer smallest{logbatch::kMinDatagramSize};
+  EXPECT_EQ(smallest.maxRecordSize(), 0);
+  logbatch::Writer largest{logbatch::kMaxDatagramSize};
+  largest.append(logbatch::RecordKind::Text, std::string(largest.maxRecordSize(), 'x'));
+  std::uint64_t sequence = 0;
+  std::vector<Record> records;
+  ASSERT_TRUE(parseAll(largest.data(), sequence, records));
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].second.size(), largest.maxRecordSize());
+}
+
+TEST(LogBatchTest, ResetStartsANewBatch)
+{
+  logbatch::Writer writer{logbatch::kDefaultDatagramSize};
+  writer.append(logbatch::RecordKind::Text, "old");
+  writer.reset(7);
+  writer.append(logbatch::RecordKind::Text, "new");
+  std::uint64_t sequence = 0;
+  std::vector<Record> records;
+  ASSERT_TRUE(parseAll(writer.data(), sequence, records));
+  EXPECT_EQ(sequence, 7);
+  EXPECT_EQ(records, (std::vector<Record>{{logbatch::RecordKind::Text, "new"}}));
+}
+
+TEST(LogBatchTest, RejectsForeignDatagrams)
+{
+  std::uint64_t sequence = 0;
+  std::vector<Record> records;
+  EXPECT_FALSE(parseAll("", sequence, records));
+  EXPECT_FALSE(parseAll("Hello, World and then some", sequence, records));
+
+  logbatch::Writer writer{logbatch::kDefaultDatagramSize};
+  std::string wrongVersion = writer.data();
+  logbatch::put<std::uint16_t>(&wrongVersion[4], logbatch::kVersion + 1);
+  EXPECT_FALSE(parseAll(wrongVersion, sequence, records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST(LogBatchTest, TruncatedBatchDeliversCompleteRecordsOnly)
+{
+  logbatch::Writer writer{logbatch::kDefaultDatagramSize};
+  writer.append(logbatch::RecordKind::Text, "first");
+  writer.append(logbatch::RecordKind::Text, "second");
+  std::string truncated = writer.data().substr(0, writer.data().size() - 2);
+
+  std::uint64_t sequence = 0;
+  std::vector<Record> records;
+  EXPECT_FALSE(parseAll(truncated, sequence, records));
+  EXPECT_EQ(records, (std::vector<Record>{{logbatch::RecordKind::Text, "first"}}));
+
+  // a count claiming more records than the datagram holds
+  std::string overcounted = writer.data();
+  logbatch::put<std::uint16_t>(&overcounted[6], 3);
+  records.clear();
+  EXPECT_FALSE(parseAll(overcounted, sequence, records));
+  EXPECT_EQ(records.size(), 2);
+}
+
+namespace
+{
+
+  std::uint64_t lostAfter(std::initializer_list<std::uint64_t> sequences)
+  {
+    logbatch::SequenceTracker tracker;
+    for (auto sequence : sequences)
+    {
+      tracker.track(sequence);
+    }
+    return tracker.lost();
+  }
+
+} // namespace
+
+TEST(SequenceTrackerTest, CountsGaps)
+{
+  EXPECT_EQ(lostAfter({}), 0);
+  EXPECT_EQ(lostAfter({5, 6, 7}), 0);
+  EXPECT_EQ(lostAfter({0, 3, 4, 10}), 7);
+}
+
+TEST(SequenceTrackerTest, ReorderedBatchIsNotLost)
+{
+  EXPECT_EQ(lostAfter({0, 2, 1, 3}), 0);
+  EXPECT_EQ(lostAfter({0, 4, 2, 5}), 2);
+  // the late batch must not rewind the expected sequence either
+  EXPECT_EQ(lostAfter({0, 2, 1, 3, 4}), 0);
+}
+
+TEST(SequenceTrackerTest, DuplicatesChangeNothing)
+{
+  EXPECT_EQ(lostAfter({0, 1, 1, 0, 2}), 0);
+  EXPECT_EQ(lostAfter({0, 2, 1, 1, 3}), 0);
+}
+
+TEST(SequenceTrackerTest, GapsBeyondTheReorderWindowStayLost)
+{
+  constexpr auto window = logbatch::SequenceTracker::kReorderWindow;
+  // batch 1, then 3 .. window + 1; by the time 1 turns up it is out of the window
+  EXPECT_EQ(lostAfter({0, 2, 2 + window, 1}), 1 + (window - 1));
+  EXPECT_EQ(lostAfter({0, 2 * window, 1, 2 * window - 1}), 2 * window - 2);
+}
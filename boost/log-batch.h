@@ -0,0 +1,202 @@
+#ifndef LOGBATCH_H
+#define LOGBATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <boost/endian/conversion.hpp>
+
+// Wire format shared by UdpLogSink and udp-log-collector. All integers are
+// little-endian.
+//
+//   batch:  magic u32 | version u16 | record count u16 | batch sequence u64 | records...
+//   record: kind u8 | length u16 | bytes
+//
+// The sequence increases by one per batch sent, so the collector can count
+// batches lost on the way.
+namespace logbatch
+{
+
+  constexpr std::uint32_t kMagic = 0x42474f4c;  // "LOGB"
+  constexpr std::uint16_t kVersion = 1;
+  constexpr std::size_t kHeaderSize = 4 + 2 + 2 + 8;
+  constexpr std::size_t kRecordHeaderSize = 1 + 2;
+  // 1500 byte Ethernet MTU minus IPv4 and UDP headers
+  constexpr std::size_t kDefaultDatagramSize = 1472;
+  // room for the header and one empty record
+  constexpr std::size_t kMinDatagramSize = kHeaderSize + kRecordHeaderSize;
+  // largest UDP payload over IPv4
+  constexpr std::size_t kMaxDatagramSize = 65507;
+  static_assert(kMaxDatagramSize - kMinDatagramSize <= UINT16_MAX, "record length must fit its u16 field");
+
+  enum class RecordKind : std::uint8_t
+  {
+    Text = 0,
+    Binary = 1
+  };
+
+  template <typename T>
+  void put(char *out, T value)
+  {
+    value = boost::endian::native_to_little(value);
+    std::memcpy(out, &value, sizeof(value));
+  }
+
+  template <typename T>
+  T get(const char *in)
+  {
+    T value;
+    std::memcpy(&value, in, sizeof(value));
+    return boost::endian::little_to_native(value);
+  }
+
+  // Accumulates records into one datagram-sized buffer. The datagram size
+  // must lie in [kMinDatagramSize, kMaxDatagramSize]; std::invalid_argument otherwise.
+  class Writer
+  {
+  public:
+    explicit Writer(std::size_t datagramSize) : _capacity(datagramSize)
+    {
+      if (datagramSize < kMinDatagramSize || datagramSize > kMaxDatagramSize)
+      {
+        throw std::invalid_argument("log batch datagram size must be between " + std::to_string(kMinDatagramSize) +
+                                    " and " + std::to_string(kMaxDatagramSize) + " bytes");
+      }
+      _buffer.reserve(datagramSize);
+      reset(0);
+    }
+
+    // Largest record payload that fits into an empty batch.
+    std::size_t maxRecordSize() const
+    {
+      return _capacity - kHeaderSize - kRecordHeaderSize;
+    }
+
+    bool fits(std::size_t recordSize) const
+    {
+      return _buffer.size() + kRecordHeaderSize + recordSize <= _capacity && _count < UINT16_MAX;
+    }
+
+    // The caller checks fits() first.
+    void append(RecordKind kind, std::string_view record)
+    {
+      auto offset = _buffer.size();
+      _buffer.resize(offset + kRecordHeaderSize + record.size());
+      put<std::uint8_t>(&_buffer[offset], static_cast<std::uint8_t>(kind));
+      put<std::uint16_t>(&_buffer[offset + 1], static_cast<std::uint16_t>(record.size()));
+      std::memcpy(&_buffer[offset + kRecordHeaderSize], record.data(), record.size());
+      put<std::uint16_t>(&_buffer[6], ++_count);
+    }
+
+    std::uint16_t count() const
+    {
+      return _count;
+    }
+
+    const std::string &data() const
+    {
+      return _buffer;
+    }
+
+    void reset(std::uint64_t sequence)
+    {
+      _buffer.assign(kHeaderSize, '\0');
+      put<std::uint32_t>(&_buffer[0], kMagic);
+      put<std::uint16_t>(&_buffer[4], kVersion);
+      put<std::uint16_t>(&_buffer[6], 0);
+      put<std::uint64_t>(&_buffer[8], sequence);
+      _count = 0;
+    }
+
+  private:
+    std::size_t _capacity;
+    std::string _buffer;
+    std::uint16_t _count = 0;
+  };
+
+  // Walks the records of a received batch. Returns false if the datagram is
+  // not a well-formed batch; records before the malformed point are still delivered.
+  template <typename OnRecord>
+  bool parse(std::string_view datagram, std::uint64_t &sequence, OnRecord &&onRecord)
+  {
+    if (datagram.size() < kHeaderSize || get<std::uint32_t>(datagram.data()) != kMagic ||
+        get<std::uint16_t>(datagram.data() + 4) != kVersion)
+    {
+      return false;
+    }
+    auto count = get<std::uint16_t>(datagram.data() + 6);
+    sequence = get<std::uint64_t>(datagram.data() + 8);
+    std::size_t offset = kHeaderSize;
+    for (std::uint16_t i = 0; i < count; ++i)
+    {
+      if (offset + kRecordHeaderSize > datagram.size())
+      {
+        return false;
+      }
+      auto kind = static_cast<RecordKind>(get<std::uint8_t>(datagram.data() + offset));
+      auto length = get<std::uint16_t>(datagram.data() + offset + 1);
+      offset += kRecordHeaderSize;
+      if (offset + length > datagram.size())
+      {
+        return false;
+      }
+      onRecord(kind, datagram.substr(offset, length));
+      offset += length;
+    }
+    return true;
+  }
+
+  // Counts the batches one sender lost, from the gaps in its sequence numbers.
+  // A batch that arrives out of order, within kReorderWindow of the newest one,
+  // is taken off the lost count again; duplicates change nothing.
+  class SequenceTracker
+  {
+  public:
+    static constexpr std::uint64_t kReorderWindow = 1024;
+
+    void track(std::uint64_t sequence)
+    {
+      if (!_started)
+      {
+        _started = true;
+        _next = sequence + 1;
+        return;
+      }
+      if (sequence >= _next)
+      {
+        _lost += sequence - _next;
+        for (auto missing = std::max(_next, sequence - std::min(sequence, kReorderWindow)); missing < sequence;
+             ++missing)
+        {
+          _missing.insert(missing);
+        }
+        _next = sequence + 1;
+        // gaps that fell out of the window stay lost
+        _missing.erase(_missing.begin(), _missing.lower_bound(_next - std::min(_next, kReorderWindow)));
+      }
+      else if (_missing.erase(sequence) > 0)
+      {
+        --_lost;
+      }
+    }
+
+    std::uint64_t lost() const
+    {
+      return _lost;
+    }
+
+  private:
+    bool _started = false;
+    std::uint64_t _next = 0;
+    std::uint64_t _lost = 0;
+    std::set<std::uint64_t> _missing;
+  };
+
+} // namespace logbatch
+
+#endif
@@ -0,0 +1,131 @@
+#include "rate-limiter.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using boost::asio::ip::udp;
+using namespace std::chrono_literals;
+
+class EndpointTokenBucketsTest : public testing::Test
+{
+protected:
+  static udp::endpoint source(unsigned short port)
+  {
+    return udp::endpoint(boost::asio::ip::address_v4::loopback(), port);
+  }
+
+  EndpointTokenBuckets::Clock::time_point t0{};
+};
+
+TEST_F(EndpointTokenBucketsTest, BurstThenThrottled)
+{
+  EndpointTokenBuckets buckets{10, 3, 64};
+  for (int i = 0; i < 3; ++i)
+  {
+    EXPECT_TRUE(buckets.tryConsume(source(1), t0));
+  }
+  EXPECT_FALSE(buckets.tryConsume(source(1), t0));
+}
+
+TEST_F(EndpointTokenBucketsTest, RefillsAtRate)
+{
+  EndpointTokenBuckets buckets{10, 3, 64};
+  for (int i = 0; i < 3; ++i)
+  {
+    EXPECT_TRUE(buckets.tryConsume(source(1), t0));
+  }
+  // 10 per second: one token every 100ms
+  EXPECT_FALSE(buckets.tryConsume(source(1), t0 + 99ms));
+  EXPECT_TRUE(buckets.tryConsume(source(1), t0 + 100ms));
+  EXPECT_FALSE(buckets.tryConsume(source(1), t0 + 100ms));
+}
+
+TEST_F(EndpointTokenBucketsTest, RefillIsCappedAtBurst)
+{
+  EndpointTokenBuckets buckets{10, 3, 64};
+  EXPECT_TRUE(buckets.tryConsume(source(1), t0));
+  auto later = t0 + 10s;
+  for (int i = 0; i < 3; ++i)
+  {
+    EXPECT_TRUE(buckets.tryConsume(source(1), later));
+  }
+  EXPECT_FALSE(buckets.tryConsume(source(1), later));
+}
+
+TEST_F(EndpointTokenBucketsTest, SourcesHaveTheirOwnBuckets)
+{
+  EndpointTokenBuckets buckets{1, 1, 64};
+  EXPECT_TRUE(buckets.tryConsume(source(1), t0));
+  EXPECT_FALSE(buckets.tryConsume(source(1), t0));
+  EXPECT_TRUE(buckets.tryConsume(source(2), t0));
+  udp::endpoint other(boost::asio::ip::make_address_v4("10.0.0.1"), 1);
+  EXPECT_TRUE(buckets.tryConsume(other, t0));
+}
+
+TEST_F(EndpointTokenBucketsTest, FullProbeWindowEvictsStalestSource)
+{
+  // the smallest table is one probe window, so every source competes for it
+  EndpointTokenBuckets buckets{1, 1, 1};
+  ASSERT_EQ(buckets.capacity(), 8);
+  for (unsigned short port = 1; port <= 8; ++port)
+  {
+    EXPECT_TRUE(buckets.tryConsume(source(port), t0 + port * 1ms));
+  }
+  // a ninth source takes over the bucket of source 1, the quietest one
+  EXPECT_TRUE(buckets.tryConsume(source(9), t0 + 9ms));
+  EXPECT_FALSE(buckets.tryConsume(source(8), t0 + 10ms));
+  // source 1 starts over with a full bucket, evicting source 2 in turn
+  EXPECT_TRUE(buckets.tryConsume(source(1), t0 + 11ms));
+  EXPECT_FALSE(buckets.tryConsume(source(9), t0 + 12ms));
+}
+
+TEST(AdmissionControlTest, DisabledChecksAcceptEverything)
+{
+  AdmissionControl admission{AdmissionControl::Options{}};
+  udp::endpoint remote(boost::asio::ip::address_v4::loopback(), 1);
+  for (std::size_t depth = 0; depth < 1000; ++depth)
+  {
+    EXPECT_EQ(admission.admit(remote, depth, {}), Admission::Accepted);
+  }
+  EXPECT_EQ(admission.accepted(), 1000);
+}
+
+TEST(AdmissionControlTest, ShedsAtQueueDepth)
+{
+  AdmissionControl::Options options;
+  options.shedDepth = 4;
+  AdmissionControl admission{options};
+  udp::endpoint remote(boost::asio::ip::address_v4::loopback(), 1);
+  EXPECT_EQ(admission.admit(remote, 3, {}), Admission::Accepted);
+  EXPECT_EQ(admission.admit(remote, 4, {}), Admission::Shed);
+  EXPECT_EQ(admission.admit(remote, 5, {}), Admission::Shed);
+  EXPECT_EQ(admission.accepted(), 1);
+  EXPECT_EQ(admission.shed(), 2);
+}
+
+TEST(AdmissionControlTest, BurstDefaultsToOneSecondOfRate)
+{
+  AdmissionControl::Options options;
+  options.ratePerSource = 5;
+  AdmissionControl admission{options};
+  udp::endpoint remote(boost::asio::ip::address_v4::loopback(), 1);
+  EndpointTokenBuckets::Clock::time_point now{};
+  for (int i = 0; i < 5; ++i)
+  {
+    EXPECT_EQ(admission.admit(remote, 0, now), Admission::Accepted);
+  }
+  EXPECT_EQ(admission.admit(remote, 0, now), Admission::Throttled);
+  EXPECT_EQ(admission.throttled(), 1);
+}
+
+TEST(AdmissionControlTest, ThrottledSourcesDoNotCountAsShed)
+{
+  AdmissionControl::Options options;
+  options.ratePerSource = 1;
+  options.shedDepth = 1;
+  AdmissionControl admission{options};
+  udp::endpoint remote(boost::asio::ip::address_v4::loopback(), 1);
+  EndpointTokenBuckets::Clock::time_point now{};
+  EXPECT_EQ(admission.admit(remote, 0, now), Admission::Accepted);
+  EXPECT_EQ(admission.admit(remote, 1, now), Admission::Throttled);
+  EXPECT_EQ(admission.shed(), 0);
+}
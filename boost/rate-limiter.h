@@ -0,0 +1,194 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <boost/asio/ip/udp.hpp>
+#include "../lockfree/pow2.h"
+
+// One token bucket per remote endpoint, stored inline in an open-addressing
+// table with linear probing. Lookups touch one or two cache lines and never
+// allocate. The table does not grow: when a probe window is full, the sender
+// that has been quiet the longest is evicted (and starts over with a full
+// bucket if it comes back).
+//
+// Not thread-safe; it belongs to the server's I/O thread.
+class EndpointTokenBuckets
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  EndpointTokenBuckets(double ratePerSecond, double burst, std::size_t capacity) :
+      _slots(round_up_pow2(capacity, kMaxProbe)),
+      _mask(_slots.size() - 1),
+      _ratePerNano(ratePerSecond / 1e9),
+      _burst(std::max(burst, 1.0))
+  {
+  }
+
+  // Takes one token from the sender's bucket; false means over its rate.
+  bool tryConsume(const boost::asio::ip::udp::endpoint &remote, Clock::time_point now)
+  {
+    auto key = keyOf(remote);
+    auto nanos = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+    Slot &slot = find(key);
+    if (slot.key != key)
+    {
+      slot = Slot{key, _burst, nanos};
+    }
+    else if (nanos > slot.lastRefill)
+    {
+      slot.tokens = std::min(_burst, slot.tokens + (nanos - slot.lastRefill) * _ratePerNano);
+      slot.lastRefill = nanos;
+    }
+    if (slot.tokens < 1.0)
+    {
+      return false;
+    }
+    slot.tokens -= 1.0;
+    return true;
+  }
+
+  std::size_t capacity() const
+  {
+    return _slots.size();
+  }
+
+private:
+  static constexpr std::size_t kMaxProbe = 8;
+
+  struct Slot
+  {
+    std::uint64_t key = 0;  // 0 marks an empty slot, real keys always have the top bit set
+    double tokens = 0;
+    std::uint64_t lastRefill = 0;
+  };
+
+  // IPv4 endpoints map to a unique key. IPv6 ones are folded into 62 bits, so
+  // two addresses may share a bucket, which only makes the limit stricter.
+  static std::uint64_t keyOf(const boost::asio::ip::udp::endpoint &remote)
+  {
+    auto address = remote.address();
+    if (address.is_v4())
+    {
+      return (std::uint64_t{2} << 62) | (std::uint64_t{address.to_v4().to_uint()} << 16) | remote.port();
+    }
+    std::uint64_t hash = remote.port();
+    for (auto byte : address.to_v6().to_bytes())
+    {
+      hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+    return (std::uint64_t{3} << 62) | (hash >> 2);
+  }
+
+  static std::uint64_t mix(std::uint64_t key)
+  {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+  }
+
+  // Returns the slot holding key, else an empty slot, else the stalest slot in
+  // the probe window for the caller to take over.
+  Slot &find(std::uint64_t key)
+  {
+    auto index = mix(key) & _mask;
+    Slot *victim = nullptr;
+    for (std::size_t probe = 0; probe < kMaxProbe; ++probe)
+    {
+      Slot &slot = _slots[(index + probe) & _mask];
+      if (slot.key == key || slot.key == 0)
+      {
+        return slot;
+      }
+      if (victim == nullptr || slot.lastRefill < victim->lastRefill)
+      {
+        victim = &slot;
+      }
+    }
+    return *victim;
+  }
+
+  std::vector<Slot> _slots;
+  std::size_t _mask;
+  double _ratePerNano;
+  double _burst;
+};
+
+enum class Admission
+{
+  Accepted,
+  Throttled,  // the sender is over its own rate
+  Shed        // the server as a whole is over its queue depth
+};
+
+// Decides, before any handler work, whether a datagram is served at all.
+// Either check is disabled by leaving its option at zero.
+class AdmissionControl
+{
+public:
+  struct Options
+  {
+    double ratePerSource = 0;       // datagrams per second per remote endpoint
+    double burst = 0;               // bucket size; defaults to one second worth of rate
+    std::size_t tableCapacity = 65536;
+    std::size_t shedDepth = 0;      // admitted-but-unanswered requests beyond which new ones are shed
+  };
+
+  explicit AdmissionControl(const Options &options) :
+      _buckets(options.ratePerSource, options.burst > 0 ? options.burst : options.ratePerSource,
+               options.ratePerSource > 0 ? options.tableCapacity : 0),
+      _limitSources(options.ratePerSource > 0),
+      _shedDepth(options.shedDepth)
+  {
+  }
+
+  Admission admit(const boost::asio::ip::udp::endpoint &remote, std::size_t queueDepth,
+                  EndpointTokenBuckets::Clock::time_point now)
+  {
+    if (_limitSources && !_buckets.tryConsume(remote, now))
+    {
+      _throttled.fetch_add(1, std::memory_order_relaxed);
+      return Admission::Throttled;
+    }
+    if (_shedDepth > 0 && queueDepth >= _shedDepth)
+    {
+      _shed.fetch_add(1, std::memory_order_relaxed);
+      return Admission::Shed;
+    }
+    _accepted.fetch_add(1, std::memory_order_relaxed);
+    return Admission::Accepted;
+  }
+
+  std::uint64_t accepted() const
+  {
+    return _accepted.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t throttled() const
+  {
+    return _throttled.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t shed() const
+  {
+    return _shed.load(std::memory_order_relaxed);
+  }
+
+private:
+  EndpointTokenBuckets _buckets;
+  bool _limitSources;
+  std::size_t _shedDepth;
+  std::atomic<std::uint64_t> _accepted{0};
+  std::atomic<std::uint64_t> _throttled{0};
+  std::atomic<std::uint64_t> _shed{0};
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef REQUESTHANDLER_H
+#define REQUESTHANDLER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <boost/asio/ip/udp.hpp>
+
+// Where the server runs RequestHandler::handle for a given datagram.
+enum class DispatchMode
+{
+  Inline,  // on the I/O thread, right after the receive completes
+  Offload  // on a WorkerPool thread; the reply is sent back through the io_service
+};
+
+inline const char *toString(DispatchMode mode)
+{
+  return mode == DispatchMode::Inline ? "inline" : "offload";
+}
+
+// Application logic plugged into the UDP server: turns one request datagram into
+// one reply datagram.
+class RequestHandler
+{
+public:
+  virtual ~RequestHandler() = default;
+
+  // Called on the I/O thread for every datagram before handle(); keep it cheap.
+  // Expensive requests should be routed to DispatchMode::Offload so they do not
+  // stall the receive loop.
+  virtual DispatchMode dispatchMode(std::string_view) const
+  {
+    return DispatchMode::Inline;
+  }
+
+  // Parses the request and computes the reply. Offloaded calls run concurrently
+  // on worker threads, so implementations must be thread-safe if they offload.
+  virtual std::string handle(std::string_view request, const boost::asio::ip::udp::endpoint &remote) = 0;
+};
+
+// The original behaviour: answer every datagram with a greeting.
+class HelloWorldHandler : public RequestHandler
+{
+public:
+  explicit HelloWorldHandler(DispatchMode mode = DispatchMode::Inline) : _mode(mode) {}
+
+  DispatchMode dispatchMode(std::string_view) const override
+  {
+    return _mode;
+  }
+
+  std::string handle(std::string_view, const boost::asio::ip::udp::endpoint &) override
+  {
+    return "Hello, World\n";
+  }
+
+private:
+  DispatchMode _mode;
+};
+
+// Replies with the request itself. Used with the udp-client load generator, which
+// relies on its sequence number and send timestamp coming back untouched.
+class EchoHandler : public RequestHandler
+{
+public:
+  explicit EchoHandler(DispatchMode mode = DispatchMode::Inline) : _mode(mode) {}
+
+  DispatchMode dispatchMode(std::string_view) const override
+  {
+    return _mode;
+  }
+
+  std::string handle(std::string_view request, const boost::asio::ip::udp::endpoint &) override
+  {
+    return std::string(request);
+  }
+
+private:
+  DispatchMode _mode;
+};
+
+// Adapts a plain callback, for handlers that do not need their own class.
+class FunctionHandler : public RequestHandler
+{
+public:
+  using Callback = std::function<std::string(std::string_view, const boost::asio::ip::udp::endpoint &)>;
+
+  FunctionHandler(Callback callback, DispatchMode mode) : _callback(std::move(callback)), _mode(mode) {}
+
+  DispatchMode dispatchMode(std::string_view) const override
+  {
+    return _mode;
+  }
+
+  std::string handle(std::string_view request, const boost::asio::ip::udp::endpoint &remote) override
+  {
+    return _callback(request, remote);
+  }
+
+private:
+  Callback _callback;
+  DispatchMode _mode;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "server-metrics.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(OwnedCounterTest, AddsAndLoads)
+{
+  OwnedCounter counter;
+  EXPECT_EQ(counter.load(), 0);
+  counter.add();
+  counter.add(5);
+  EXPECT_EQ(counter.load(), 6);
+}
+
+TEST(OwnedCounterTest, ReaderSeesMonotonicValues)
+{
+  OwnedCounter counter;
+  constexpr std::uint64_t kIncrements = 100000;
+  std::thread writer([&]()
+                     {
+                       for (std::uint64_t i = 0; i < kIncrements; ++i)
+                       {
+                         counter.add();
+                       }
+                     });
+  std::uint64_t last = 0;
+  while (last < kIncrements)
+  {
+    auto value = counter.load();
+    ASSERT_GE(value, last);
+    last = value;
+  }
+  writer.join();
+  EXPECT_EQ(counter.load(), kIncrements);
+}
+
+TEST(ServerMetricsTest, ShardsOfAllThreadsAreSummed)
+{
+  ServerMetrics metrics;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&metrics]()
+                         {
+                           auto &shard = metrics.local();
+                           for (int i = 0; i < 10; ++i)
+                           {
+                             shard.packetsIn.add();
+                             shard.bytesIn.add(100);
+                           }
+                           shard.receiveToSend[static_cast<std::size_t>(DispatchMode::Offload)].recordOwned(2000);
+                         });
+  }
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+  metrics.local().sendErrors.add();
+  EXPECT_EQ(metrics.shards(), 5);
+
+  std::ostringstream out;
+  metrics.print(out);
+  EXPECT_EQ(out.str(), "packets_in 40\n"
+                       "packets_out 0\n"
+                       "bytes_in 4000\n"
+                       "bytes_out 0\n"
+                       "truncated 0\n"
+                       "receive_errors 0\n"
+                       "send_errors 1\n"
+                       "latency_inline n=0 mean=0.0us p50=0.0us p99=0.0us p99.9=0.0us max=0.0us\n"
+                       "latency_offload n=4 mean=2.0us p50=2.0us p99=2.0us p99.9=2.0us max=2.0us\n");
+}
+
+TEST(ServerMetricsTest, AlternatingRegistriesKeepOneShardEach)
+{
+  ServerMetrics first;
+  ServerMetrics second;
+  for (int i = 0; i < 100; ++i)
+  {
+    first.local().packetsIn.add();
+    second.local().packetsIn.add();
+  }
+  EXPECT_EQ(first.shards(), 1);
+  EXPECT_EQ(second.shards(), 1);
+  EXPECT_EQ(first.local().packetsIn.load(), 100);
+  EXPECT_EQ(second.local().packetsIn.load(), 100);
+}
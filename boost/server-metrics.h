@@ -0,0 +1,203 @@
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "latency-histogram.h"
+#include "request-handler.h"
+
+// Counter written by exactly one thread and read by any. The update is a plain
+// load and store, so there is no locked instruction on the hot path; readers
+// may see a value that is a few increments old.
+class OwnedCounter
+{
+public:
+  void add(std::uint64_t amount = 1)
+  {
+    _value.store(_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  std::uint64_t load() const
+  {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::uint64_t> _value{0};
+};
+
+// Everything one thread records. Shards are cache-line aligned so two threads
+// never write to the same line.
+struct alignas(64) MetricsShard
+{
+  OwnedCounter packetsIn;
+  OwnedCounter packetsOut;
+  OwnedCounter bytesIn;
+  OwnedCounter bytesOut;
+  OwnedCounter truncated;  // datagrams larger than the receive buffer
+  OwnedCounter receiveErrors;
+  OwnedCounter sendErrors;
+  // receive to send completion, indexed by DispatchMode; written with recordOwned()
+  std::array<LatencyHistogram, 2> receiveToSend;
+};
+
+// Registry of per-thread shards. Recording never synchronises with other
+// threads; only the first call from a new thread takes a lock to register its
+// shard. Reading sums all shards and may run concurrently with recording.
+class ServerMetrics
+{
+public:
+  ServerMetrics() : _id(nextId()) {}
+
+  // The calling thread's shard, registered on first use. Each thread remembers
+  // its shard per registry, so switching between registries never adds another;
+  // the one used last is found without a lookup.
+  MetricsShard &local()
+  {
+    thread_local std::uint64_t lastOwner = 0;
+    thread_local MetricsShard *lastShard = nullptr;
+    if (lastOwner != _id)
+    {
+      thread_local std::unordered_map<std::uint64_t, MetricsShard *> shards;
+      auto &shard = shards[_id];
+      if (shard == nullptr)
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shards.push_back(std::make_unique<MetricsShard>());
+        shard = _shards.back().get();
+      }
+      lastOwner = _id;
+      lastShard = shard;
+    }
+    return *lastShard;
+  }
+
+  // number of threads that have recorded into this registry
+  std::size_t shards() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _shards.size();
+  }
+
+  // Plain-text dump, one "name value" pair per line.
+  void print(std::ostream &out) const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto sum = [this](OwnedCounter MetricsShard::*counter)
+    {
+      std::uint64_t total = 0;
+      for (auto &shard : _shards)
+      {
+        total += ((*shard).*counter).load();
+      }
+      return total;
+    };
+    out << "packets_in " << sum(&MetricsShard::packetsIn) << "\n"
+        << "packets_out " << sum(&MetricsShard::packetsOut) << "\n"
+        << "bytes_in " << sum(&MetricsShard::bytesIn) << "\n"
+        << "bytes_out " << sum(&MetricsShard::bytesOut) << "\n"
+        << "truncated " << sum(&MetricsShard::truncated) << "\n"
+        << "receive_errors " << sum(&MetricsShard::receiveErrors) << "\n"
+        << "send_errors " << sum(&MetricsShard::sendErrors) << "\n";
+    for (auto mode : {DispatchMode::Inline, DispatchMode::Offload})
+    {
+      auto merged = std::make_unique<LatencyHistogram>();
+      for (auto &shard : _shards)
+      {
+        merged->merge(shard->receiveToSend[static_cast<std::size_t>(mode)]);
+      }
+      out << "latency_" << toString(mode) << " ";
+      merged->print(out);
+      out << "\n";
+    }
+  }
+
+private:
+  // ids rather than addresses, so a registry reusing a dead one's address is not mistaken for it
+  static std::uint64_t nextId()
+  {
+    static std::atomic<std::uint64_t> counter{0};
+    return ++counter;
+  }
+
+  std::uint64_t _id;
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<MetricsShard>> _shards;
+};
+
+// Publishes a text report on a loopback-only UDP port (any datagram gets the
+// current report back, e.g. `echo | nc -u -w1 127.0.0.1 PORT`) and/or writes it
+// to a stream at a fixed interval. Either is disabled with a zero port or interval.
+class StatsReporter
+{
+public:
+  using Render = std::function<std::string()>;
+
+  StatsReporter(boost::asio::io_service &io_service, Render render, unsigned short port,
+                std::chrono::seconds interval, std::ostream &out)
+      : _socket(io_service), _timer(io_service), _render(std::move(render)), _interval(interval), _out(out)
+  {
+    if (port != 0)
+    {
+      _socket.open(boost::asio::ip::udp::v4());
+      _socket.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+      startReceive();
+    }
+    if (interval.count() > 0)
+    {
+      startTimer();
+    }
+  }
+
+private:
+  void startReceive()
+  {
+    _socket.async_receive_from(boost::asio::buffer(_recvBuffer), _remoteEndpoint,
+                               [this](const boost::system::error_code &error, std::size_t)
+                               {
+                                 if (error == boost::asio::error::operation_aborted)
+                                 {
+                                   return;
+                                 }
+                                 auto report = std::make_shared<std::string>(_render());
+                                 _socket.async_send_to(boost::asio::buffer(*report), _remoteEndpoint,
+                                                       [report](const boost::system::error_code &, std::size_t) {});
+                                 startReceive();
+                               });
+  }
+
+  void startTimer()
+  {
+    _timer.expires_after(_interval);
+    _timer.async_wait([this](const boost::system::error_code &error)
+                      {
+                        if (error)
+                        {
+                          return;
+                        }
+                        _out << _render() << std::flush;
+                        startTimer();
+                      });
+  }
+
+  boost::asio::ip::udp::socket _socket;
+  boost::asio::steady_timer _timer;
+  Render _render;
+  std::chrono::seconds _interval;
+  std::ostream &_out;
+  boost::asio::ip::udp::endpoint _remoteEndpoint;
+  std::array<char, 64> _recvBuffer;
+};
+
+#endif
@@ -1,12 +1,470 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <boost/asio.hpp>
+#include "async-udp-client.h"
+#include "latency-histogram.h"
 
 using boost::asio::ip::udp;
 
-int main()
+namespace
 {
-  try
+
+  using Clock = std::chrono::steady_clock;
+
+  // Leading bytes of every load-generator datagram. The server must echo them
+  // back unchanged (udp-server --echo) for replies to be matched to their requests.
+  struct ProbeHeader
+  {
+    std::uint64_t sequence;
+    std::uint64_t sentNanos;
+  };
+
+  std::uint64_t nowNanos()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+  }
+
+  struct LoadOptions
+  {
+    std::string host = "127.0.0.1";
+    unsigned short port = 1111;
+    std::size_t concurrency = 1;         // sockets
+    std::size_t threads = 1;             // io_service threads the sockets are spread over
+    double rate = 0;                     // total datagrams per second; 0 means closed loop
+    std::size_t window = 1;              // closed loop: requests in flight per socket
+    std::size_t payload = 64;            // datagram size in bytes, at least sizeof(ProbeHeader)
+    std::chrono::milliseconds duration{10000};
+    std::chrono::milliseconds drain{500};  // how long to wait for stragglers after the last send
+  };
+
+  // Owned by one LoadThread and only read once it has finished, so the threads
+  // never share a cache line while measuring.
+  struct alignas(64) LoadStats
+  {
+    std::uint64_t sent = 0;
+    std::uint64_t received = 0;
+    std::uint64_t sendDropped = 0;  // socket buffer full (would_block)
+    std::uint64_t sendErrors = 0;
+    std::uint64_t expired = 0;      // no reply within LoadConnection::kReplyTimeout
+    std::uint64_t late = 0;         // replies to expired requests, and duplicates
+    LatencyHistogram rtt;
+
+    void merge(const LoadStats &other)
+    {
+      sent += other.sent;
+      received += other.received;
+      sendDropped += other.sendDropped;
+      sendErrors += other.sendErrors;
+      expired += other.expired;
+      late += other.late;
+      rtt.merge(other.rtt);
+    }
+  };
+
+  // One socket, either paced by its LoadThread (open loop) or sending a new
+  // request whenever a reply arrives (closed loop).
+  class LoadConnection
+  {
+  public:
+    LoadConnection(boost::asio::io_service &io_service, const udp::endpoint &server, const LoadOptions &options,
+                   LoadStats &stats)
+        : _socket(io_service), _server(server), _options(options), _stats(stats),
+          _sendBuffer(std::max(options.payload, sizeof(ProbeHeader)), 'x')
+    {
+      _socket.open(udp::v4());
+      // Sends are synchronous and must never stall the receive side of the loop.
+      _socket.non_blocking(true);
+    }
+
+    void start(Clock::time_point deadline)
+    {
+      _deadline = deadline;
+      startReceive();
+      if (closedLoop())
+      {
+        refill();
+      }
+    }
+
+    void send()
+    {
+      ProbeHeader header{_sequence, nowNanos()};
+      std::memcpy(_sendBuffer.data(), &header, sizeof(header));
+      boost::system::error_code ec;
+      _socket.send_to(boost::asio::buffer(_sendBuffer), _server, 0, ec);
+      if (!ec)
+      {
+        ++_stats.sent;
+        ++_inFlight;
+        ++_sequence;
+        _sentNanos.push_back(header.sentNanos);
+      }
+      else if (ec == boost::asio::error::would_block)
+      {
+        ++_stats.sendDropped;
+      }
+      else
+      {
+        ++_stats.sendErrors;
+      }
+    }
+
+    // Gives up on requests that have waited kReplyTimeout for their reply. In a
+    // closed loop their slots in the window are refilled right away.
+    void expire(Clock::time_point now)
+    {
+      std::uint64_t oldest =
+              std::chrono::duration_cast<std::chrono::nanoseconds>((now - kReplyTimeout).time_since_epoch()).count();
+      std::size_t expired = 0;
+      while (!_sentNanos.empty() && (_sentNanos.front() == kAnswered || _sentNanos.front() < oldest))
+      {
+        if (_sentNanos.front() != kAnswered)
+        {
+          ++expired;
+        }
+        _sentNanos.pop_front();
+        ++_oldestSequence;
+      }
+      _stats.expired += expired;
+      _inFlight -= expired;
+      if (closedLoop() && expired > 0 && now < _deadline)
+      {
+        refill();
+      }
+    }
+
+    std::size_t inFlight() const
+    {
+      return _inFlight;
+    }
+
+    void stop()
+    {
+      boost::system::error_code ec;
+      _socket.close(ec);
+    }
+
+  private:
+    static constexpr std::chrono::milliseconds kReplyTimeout{200};
+    static constexpr std::uint64_t kAnswered = 0;
+
+    bool closedLoop() const
+    {
+      return _options.rate <= 0;
+    }
+
+    void refill()
+    {
+      while (_inFlight < _options.window && Clock::now() < _deadline)
+      {
+        auto before = _inFlight;
+        send();
+        if (_inFlight == before)
+        {
+          break;
+        }
+      }
+    }
+
+    void startReceive()
+    {
+      _socket.async_receive_from(boost::asio::buffer(_recvBuffer), _replyEndpoint,
+                                 [this](const boost::system::error_code &error, std::size_t bytes_transferred)
+                                 { handleReceive(error, bytes_transferred); });
+    }
+
+    void handleReceive(const boost::system::error_code &error, std::size_t bytes_transferred)
+    {
+      if (error == boost::asio::error::operation_aborted)
+      {
+        return;
+      }
+      if ((!error || error == boost::asio::error::message_size) && bytes_transferred >= sizeof(ProbeHeader))
+      {
+        ProbeHeader header;
+        std::memcpy(&header, _recvBuffer.data(), sizeof(header));
+        // only the first reply to a request that has not expired yet counts
+        auto index = header.sequence - _oldestSequence;
+        if (header.sequence < _oldestSequence || index >= _sentNanos.size() || _sentNanos[index] == kAnswered)
+        {
+          ++_stats.late;
+        }
+        else
+        {
+          _stats.rtt.recordOwned(nowNanos() - _sentNanos[index]);
+          _sentNanos[index] = kAnswered;
+          ++_stats.received;
+          --_inFlight;
+          if (closedLoop())
+          {
+            refill();
+          }
+        }
+      }
+      startReceive();
+    }
+
+    udp::socket _socket;
+    udp::endpoint _server;
+    udp::endpoint _replyEndpoint;
+    const LoadOptions &_options;
+    LoadStats &_stats;
+    std::vector<char> _sendBuffer;
+    std::array<char, 65536> _recvBuffer;
+    // send times of requests _oldestSequence onwards, kAnswered once the reply is in
+    std::deque<std::uint64_t> _sentNanos;
+    std::uint64_t _oldestSequence = 0;
+    std::uint64_t _sequence = 0;
+    std::size_t _inFlight = 0;
+    Clock::time_point _deadline;
+  };
+
+  // An io_service, the connections it owns and the pacing timer that spreads
+  // this thread's share of the target rate over them.
+  class LoadThread
+  {
+  public:
+    LoadThread(const udp::endpoint &server, const LoadOptions &options, std::size_t connections, double rate)
+        : _timer(_io_service), _options(options), _rate(rate)
+    {
+      for (std::size_t i = 0; i < connections; ++i)
+      {
+        _connections.push_back(std::make_unique<LoadConnection>(_io_service, server, options, _stats));
+      }
+    }
+
+    void run(Clock::time_point start)
+    {
+      _start = start;
+      _deadline = start + _options.duration;
+      for (auto &connection : _connections)
+      {
+        connection->start(_deadline);
+      }
+      _nextTick = start;
+      scheduleTick();
+      _io_service.run();
+    }
+
+    const LoadStats &stats() const
+    {
+      return _stats;
+    }
+
+  private:
+    static constexpr std::chrono::microseconds kTick{100};
+    // Upper bound on datagrams sent per tick, so a stalled thread does not try
+    // to catch up with one giant burst.
+    static constexpr std::uint64_t kMaxBurst = 1024;
+
+    void scheduleTick()
+    {
+      _nextTick += kTick;
+      _timer.expires_at(_nextTick);
+      _timer.async_wait([this](const boost::system::error_code &error)
+                        {
+                          if (!error)
+                          {
+                            tick();
+                          }
+                        });
+    }
+
+    void tick()
+    {
+      auto now = Clock::now();
+      for (auto &connection : _connections)
+      {
+        connection->expire(now);
+      }
+      if (now >= _deadline + _options.drain || (now >= _deadline && inFlight() == 0))
+      {
+        for (auto &connection : _connections)
+        {
+          connection->stop();
+        }
+        return;
+      }
+      if (now < _deadline)
+      {
+        if (_rate > 0)
+        {
+          pace(now);
+        }
+      }
+      scheduleTick();
+    }
+
+    std::size_t inFlight() const
+    {
+      std::size_t total = 0;
+      for (auto &connection : _connections)
+      {
+        total += connection->inFlight();
+      }
+      return total;
+    }
+
+    // Open loop: send however many datagrams the schedule says are due, independent of replies.
+    void pace(Clock::time_point now)
+    {
+      double elapsed = std::chrono::duration<double>(now - _start).count();
+      auto due = static_cast<std::uint64_t>(elapsed * _rate);
+      auto burst = std::min(due - std::min(due, _scheduled), kMaxBurst);
+      for (std::uint64_t i = 0; i < burst; ++i)
+      {
+        _connections[_next]->send();
+        _next = (_next + 1) % _connections.size();
+      }
+      // skipped datagrams are counted as never scheduled rather than sent late
+      _scheduled = due;
+    }
+
+    boost::asio::io_service _io_service;
+    boost::asio::steady_timer _timer;
+    LoadStats _stats;
+    std::vector<std::unique_ptr<LoadConnection>> _connections;
+    const LoadOptions &_options;
+    double _rate;
+    std::uint64_t _scheduled = 0;
+    std::size_t _next = 0;
+    Clock::time_point _start;
+    Clock::time_point _deadline;
+    Clock::time_point _nextTick;
+  };
+
+  void printReport(const LoadOptions &options, const std::vector<std::unique_ptr<LoadThread>> &loadThreads,
+                   std::chrono::duration<double> elapsed)
+  {
+    LoadStats stats;
+    for (auto &loadThread : loadThreads)
+    {
+      stats.merge(loadThread->stats());
+    }
+    auto sent = stats.sent;
+    auto received = stats.received;
+    double seconds = elapsed.count();
+    double loss = sent == 0 ? 0.0 : 100.0 * (sent - std::min(sent, received)) / sent;
+
+    std::cout << (options.rate > 0 ? "open loop, target " + std::to_string(static_cast<std::uint64_t>(options.rate)) +
+                                             " pps"
+                                   : "closed loop, window " + std::to_string(options.window))
+              << ", " << options.concurrency << " sockets on " << options.threads << " threads, "
+              << std::max(options.payload, sizeof(ProbeHeader)) << " byte payload, " << seconds << "s" << std::endl;
+    std::cout << "sent:     " << sent << " (" << static_cast<std::uint64_t>(sent / seconds) << " pps)" << std::endl;
+    std::cout << "received: " << received << " (" << static_cast<std::uint64_t>(received / seconds) << " pps)"
+              << std::endl;
+    std::cout << "loss:     " << loss << "%" << std::endl;
+    std::cout << "dropped at send (socket buffer full): " << stats.sendDropped
+              << ", send errors: " << stats.sendErrors << std::endl;
+    std::cout << "expired:  " << stats.expired << ", late or duplicate replies: " << stats.late << std::endl;
+    std::cout << "rtt:      ";
+    stats.rtt.print(std::cout);
+    std::cout << std::endl;
+  }
+
+  void runLoad(const LoadOptions &options)
+  {
+    udp::endpoint server(boost::asio::ip::address::from_string(options.host), options.port);
+    auto threadCount = std::max<std::size_t>(1, std::min(options.threads, options.concurrency));
+    std::vector<std::unique_ptr<LoadThread>> loadThreads;
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+      // spread sockets and rate as evenly as possible
+      std::size_t connections = options.concurrency / threadCount + (i < options.concurrency % threadCount ? 1 : 0);
+      double rate = options.rate * connections / options.concurrency;
+      loadThreads.push_back(std::make_unique<LoadThread>(server, options, connections, rate));
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (auto &loadThread : loadThreads)
+    {
+      threads.emplace_back([&loadThread, start] { loadThread->run(start); });
+    }
+    for (auto &thread : threads)
+    {
+      thread.join();
+    }
+    // includes waiting for the last replies, as runRpc does
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    printReport(options, loadThreads, elapsed);
+  }
+
+  // Keeps --window calls in flight through a single AsyncUdpClient for the whole
+  // duration; unlike --load, lost datagrams are retransmitted by the client.
+  void runRpc(const LoadOptions &options)
+  {
+    boost::asio::io_service io_service;
+    udp::endpoint server(boost::asio::ip::address::from_string(options.host), options.port);
+    AsyncUdpClient client(io_service, server);
+    std::string payload(options.payload > AsyncUdpClient::kHeaderSize ? options.payload - AsyncUdpClient::kHeaderSize
+                                                                      : 0,
+                        'x');
+
+    LatencyHistogram rtt;
+    std::uint64_t completed = 0;
+    std::uint64_t failed = 0;
+    auto deadline = Clock::now() + options.duration;
+
+    std::function<void()> issue = [&]()
+    {
+      auto sent = Clock::now();
+      client.asyncCall(payload, [&, sent](const boost::system::error_code &ec, std::string)
+                       {
+                         auto now = Clock::now();
+                         if (!ec)
+                         {
+                           rtt.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sent).count());
+                           ++completed;
+                         }
+                         else
+                         {
+                           ++failed;
+                         }
+                         if (now < deadline)
+                         {
+                           issue();
+                         }
+                         else if (client.inFlight() == 0)
+                         {
+                           io_service.stop();
+                         }
+                       });
+    };
+    for (std::size_t i = 0; i < options.window; ++i)
+    {
+      issue();
+    }
+    auto start = Clock::now();
+    io_service.run();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    std::cout << "rpc, " << options.window << " in flight, " << elapsed.count() << "s" << std::endl;
+    std::cout << "completed: " << completed << " (" << static_cast<std::uint64_t>(completed / elapsed.count())
+              << " calls/s)" << std::endl;
+    std::cout << "timed out: " << failed << ", retransmits: " << client.retransmits()
+              << ", send failures: " << client.sendFailures() << ", rto: " << client.retransmitTimeout().count() << "us"
+              << std::endl;
+    std::cout << "rtt:       ";
+    rtt.print(std::cout);
+    std::cout << std::endl;
+  }
+
+  // The original behaviour: send one empty datagram and print the reply.
+  void runOnce(const std::string &host, unsigned short port)
   {
     // Create IO service
     boost::asio::io_service io_service;
@@ -15,10 +473,10 @@ int main()
     udp::socket socket(io_service);
     socket.open(udp::v4());
 
-    // Create endpoint for server (localhost:1111)
+    // Create endpoint for server
     udp::endpoint server_endpoint(
-        boost::asio::ip::address::from_string("127.0.0.1"),
-        1111);
+        boost::asio::ip::address::from_string(host),
+        port);
 
     // Send an empty message to trigger server response
     std::string message = "";
@@ -36,6 +494,88 @@ int main()
     // Print response
     std::cout.write(recv_buffer.data(), len);
   }
+
+  const char *kUsage =
+      "usage: udp-client [--host H] [--port P]\n"
+      "       udp-client --load [--host H] [--port P] [--concurrency N] [--threads N]\n"
+      "                  [--rate PPS | --window N] [--size BYTES] [--duration SECONDS]\n"
+      "       udp-client --rpc [--host H] [--port P] [--window N] [--size BYTES] [--duration SECONDS]\n"
+      "--rate enables open-loop pacing; without it every socket keeps --window requests in flight.\n"
+      "Point it at 'udp-server --echo' so the timestamps come back.";
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    LoadOptions options;
+    bool load = false;
+    bool rpc = false;
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string_view arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--load")
+      {
+        load = true;
+      }
+      else if (arg == "--rpc")
+      {
+        rpc = true;
+      }
+      else if (arg == "--host" && hasValue)
+      {
+        options.host = argv[++i];
+      }
+      else if (arg == "--port" && hasValue)
+      {
+        options.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--concurrency" && hasValue)
+      {
+        options.concurrency = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--threads" && hasValue)
+      {
+        options.threads = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--rate" && hasValue)
+      {
+        options.rate = std::strtod(argv[++i], nullptr);
+      }
+      else if (arg == "--window" && hasValue)
+      {
+        options.window = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--size" && hasValue)
+      {
+        options.payload = std::strtoul(argv[++i], nullptr, 10);
+      }
+      else if (arg == "--duration" && hasValue)
+      {
+        options.duration = std::chrono::milliseconds(static_cast<long>(std::strtod(argv[++i], nullptr) * 1000));
+      }
+      else
+      {
+        std::cerr << kUsage << std::endl;
+        return 1;
+      }
+    }
+
+    if (load)
+    {
+      runLoad(options);
+    }
+    else if (rpc)
+    {
+      runRpc(options);
+    }
+    else
+    {
+      runOnce(options.host, options.port);
+    }
+  }
   catch (const std::exception &ex)
   {
     std::cerr << "Exception: " << ex.what() << std::endl;
@@ -43,4 +583,4 @@ int main()
   }
 
   return 0;
-}
\ No newline at end of file
+}
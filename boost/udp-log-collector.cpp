@@ -0,0 +1,165 @@
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include "../logger/logger.h"
+#include "log-batch.h"
+
+using boost::asio::ip::udp;
+
+namespace
+{
+
+  // Receives the batches a UdpLogSink ships and writes their records out, one
+  // per line. Same receive loop as HelloWorldServer, minus the reply.
+  class LogCollectorServer
+  {
+  public:
+    LogCollectorServer(boost::asio::io_service &io_service, unsigned short port, std::ostream &out)
+        : _socket(io_service, udp::endpoint(udp::v4(), port)), _out(out)
+    {
+      startReceive();
+    }
+
+    void printStats(std::ostream &out) const
+    {
+      out << "batches " << _batches << "\n"
+          << "records " << _records << "\n"
+          << "batches_lost " << batchesLost() << "\n"
+          << "malformed " << _malformed << std::endl;
+    }
+
+  private:
+    void startReceive()
+    {
+      _socket.async_receive_from(
+          boost::asio::buffer(_recvBuffer), _remoteEndpoint,
+          boost::bind(&LogCollectorServer::handleReceive, this,
+                      boost::asio::placeholders::error,
+                      boost::asio::placeholders::bytes_transferred));
+    }
+
+    void handleReceive(const boost::system::error_code &error,
+                       std::size_t bytes_transferred)
+    {
+      if (error == boost::asio::error::operation_aborted)
+      {
+        return;
+      }
+      if (!error)
+      {
+        std::uint64_t sequence = 0;
+        auto wellFormed = logbatch::parse(std::string_view(_recvBuffer.data(), bytes_transferred), sequence,
+                                          [this](logbatch::RecordKind kind, std::string_view record)
+                                          { writeRecord(kind, record); });
+        if (wellFormed)
+        {
+          trackSequence(sequence);
+        }
+        else
+        {
+          ++_malformed;
+        }
+      }
+      else
+      {
+        // a batch bigger than the receive buffer cannot come from UdpLogSink
+        ++_malformed;
+      }
+      startReceive();
+    }
+
+    void writeRecord(logbatch::RecordKind kind, std::string_view record)
+    {
+      ++_records;
+      if (kind == logbatch::RecordKind::Text)
+      {
+        _out << record << '\n';
+        return;
+      }
+      // same form as FileSink, so the collector's output reads like a local log file
+      writeBinaryAsHex(_out, record);
+    }
+
+    // Counts batches that never arrived, per sender.
+    void trackSequence(std::uint64_t sequence)
+    {
+      ++_batches;
+      _senders[_remoteEndpoint].track(sequence);
+    }
+
+    std::uint64_t batchesLost() const
+    {
+      std::uint64_t lost = 0;
+      for (auto &sender : _senders)
+      {
+        lost += sender.second.lost();
+      }
+      return lost;
+    }
+
+    udp::socket _socket;
+    udp::endpoint _remoteEndpoint;
+    std::array<char, 65536> _recvBuffer;
+    std::ostream &_out;
+    std::map<udp::endpoint, logbatch::SequenceTracker> _senders;
+    std::uint64_t _batches = 0;
+    std::uint64_t _records = 0;
+    std::uint64_t _malformed = 0;
+  };
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    unsigned short port = 5140;
+    std::string outFile;
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string_view arg = argv[i];
+      if (arg == "--port" && i + 1 < argc)
+      {
+        port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+      }
+      else if (arg == "--out" && i + 1 < argc)
+      {
+        outFile = argv[++i];
+      }
+      else
+      {
+        std::cerr << "usage: udp-log-collector [--port P] [--out FILE]" << std::endl;
+        return 1;
+      }
+    }
+
+    std::ofstream file;
+    if (!outFile.empty())
+    {
+      file.open(outFile);
+    }
+    std::ostream &out = outFile.empty() ? std::cout : file;
+
+    boost::asio::io_service io_service;
+    LogCollectorServer server{io_service, port, out};
+
+    boost::asio::signal_set signals(io_service, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code &, int) { io_service.stop(); });
+
+    io_service.run();
+    out.flush();
+    server.printStats(std::cerr);
+  }
+  catch (const std::exception &ex)
+  {
+    std::cerr << ex.what() << std::endl;
+  }
+  return 0;
+}
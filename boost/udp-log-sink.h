@@ -0,0 +1,128 @@
+#ifndef UDPLOGSINK_H
+#define UDPLOGSINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <boost/asio.hpp>
+#include "../logger/logger.h"
+#include "log-batch.h"
+
+// Logger sink that ships records to a collector (udp-log-collector) instead of
+// a file. Records are packed into MTU-sized batches and sent from the logger's
+// backend thread on a non-blocking socket: when the collector or the network
+// cannot keep up, whole batches are dropped and counted rather than stalling
+// the logger.
+//
+// The datagram size is validated like logbatch::Writer's: std::invalid_argument
+// outside [kMinDatagramSize, kMaxDatagramSize].
+class UdpLogSink : public LogSink
+{
+public:
+  UdpLogSink(const boost::asio::ip::udp::endpoint &collector,
+             std::size_t datagramSize = logbatch::kDefaultDatagramSize)
+      : _socket(_io_service), _collector(collector), _batch(datagramSize)
+  {
+    _socket.open(collector.protocol());
+    _socket.non_blocking(true);
+  }
+
+  void write(const std::string &record) override
+  {
+    append(logbatch::RecordKind::Text, record);
+  }
+
+  void writeBinary(const std::string &bytes) override
+  {
+    append(logbatch::RecordKind::Binary, bytes);
+  }
+
+  // The logger calls this once its queue is empty, so a quiet logger still
+  // ships its last records promptly.
+  void flush() override
+  {
+    send();
+  }
+
+  // Counters may be read from any thread.
+  std::uint64_t batchesSent() const
+  {
+    return _batchesSent.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t recordsSent() const
+  {
+    return _recordsSent.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t batchesDropped() const
+  {
+    return _batchesDropped.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t recordsDropped() const
+  {
+    return _recordsDropped.load(std::memory_order_relaxed);
+  }
+
+  // Records cut down to fit into a single datagram.
+  std::uint64_t recordsTruncated() const
+  {
+    return _recordsTruncated.load(std::memory_order_relaxed);
+  }
+
+private:
+  void append(logbatch::RecordKind kind, std::string_view record)
+  {
+    if (record.size() > _batch.maxRecordSize())
+    {
+      record = record.substr(0, _batch.maxRecordSize());
+      _recordsTruncated.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!_batch.fits(record.size()))
+    {
+      send();
+    }
+    _batch.append(kind, record);
+  }
+
+  void send()
+  {
+    auto count = _batch.count();
+    if (count == 0)
+    {
+      return;
+    }
+    boost::system::error_code ec;
+    _socket.send_to(boost::asio::buffer(_batch.data()), _collector, 0, ec);
+    if (!ec)
+    {
+      _batchesSent.fetch_add(1, std::memory_order_relaxed);
+      _recordsSent.fetch_add(count, std::memory_order_relaxed);
+    }
+    else
+    {
+      // typically would_block because the socket buffer is full; never retry,
+      // the backend thread must keep draining the queue
+      _batchesDropped.fetch_add(1, std::memory_order_relaxed);
+      _recordsDropped.fetch_add(count, std::memory_order_relaxed);
+    }
+    // dropped batches use up a sequence number too, so the collector sees the gap
+    _batch.reset(++_sequence);
+  }
+
+  boost::asio::io_service _io_service;
+  boost::asio::ip::udp::socket _socket;
+  boost::asio::ip::udp::endpoint _collector;
+  logbatch::Writer _batch;
+  std::uint64_t _sequence = 0;
+  std::atomic<std::uint64_t> _batchesSent{0};
+  std::atomic<std::uint64_t> _recordsSent{0};
+  std::atomic<std::uint64_t> _batchesDropped{0};
+  std::atomic<std::uint64_t> _recordsDropped{0};
+  std::atomic<std::uint64_t> _recordsTruncated{0};
+};
+
+#endif
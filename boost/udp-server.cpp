@@ -1,27 +1,55 @@
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <thread>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include "latency-histogram.h"
+#include "rate-limiter.h"
+#include "server-metrics.h"
+#include "request-handler.h"
+#include "worker-pool.h"
+#ifdef HAVE_IO_URING
+#include <pthread.h>
+#include "uring-server.h"
+#endif
 
 using boost::asio::ip::udp;
 
 namespace
 {
 
+  using Clock = std::chrono::steady_clock;
+
   class HelloWorldServer
   {
   public:
-    HelloWorldServer(boost::asio::io_service &io_service)
-        : _socket(io_service, udp::endpoint(udp::v4(), 1111))
+    HelloWorldServer(boost::asio::io_service &io_service, RequestHandler &handler, WorkerPool &workers,
+                     AdmissionControl &admission, ServerMetrics &metrics, unsigned short port = 1111)
+        : _socket(io_service, udp::endpoint(udp::v4(), port)), _handler(handler), _workers(workers),
+          _admission(admission), _metrics(metrics)
     {
       startReceive();
     }
 
+    std::uint64_t offloadRejected() const
+    {
+      return _offloadRejected.load(std::memory_order_relaxed);
+    }
+
   private:
     void startReceive()
     {
+      // MSG_TRUNC makes Linux report the full datagram length, so oversized
+      // datagrams can be told apart (asio's message_size is Windows-only)
       _socket.async_receive_from(
-          boost::asio::buffer(_recvBuffer), _remoteEndpoint,
+          boost::asio::buffer(_recvBuffer), _remoteEndpoint, MSG_TRUNC,
           boost::bind(&HelloWorldServer::handleReceive, this,
                       boost::asio::placeholders::error,
                       boost::asio::placeholders::bytes_transferred));
@@ -30,43 +58,346 @@ namespace
     void handleReceive(const boost::system::error_code &error,
                        std::size_t bytes_transferred)
     {
-      if (!error || error == boost::asio::error::message_size)
+      if (error == boost::asio::error::operation_aborted)
+      {
+        return;
+      }
+      auto &metrics = _metrics.local();
+      if (error)
       {
+        metrics.receiveErrors.add();
+      }
+      else
+      {
+        if (bytes_transferred > _recvBuffer.size())
+        {
+          // the datagram did not fit into _recvBuffer, the handler only sees its head
+          metrics.truncated.add();
+          bytes_transferred = _recvBuffer.size();
+        }
+        metrics.packetsIn.add();
+        metrics.bytesIn.add(bytes_transferred);
+        auto received = Clock::now();
+        // Rejected datagrams get no reply at all: answering them would cost as
+        // much as the work we are trying to avoid.
+        if (_admission.admit(_remoteEndpoint, _outstanding, received) == Admission::Accepted)
+        {
+          ++_outstanding;
+          std::string_view request(_recvBuffer.data(), bytes_transferred);
 
-        auto message = std::make_shared<std::string>("Hello, World\n");
+          if (_handler.dispatchMode(request) == DispatchMode::Offload)
+          {
+            offload(request, received);
+          }
+          else
+          {
+            auto message = std::make_shared<std::string>(_handler.handle(request, _remoteEndpoint));
+            sendReply(message, _remoteEndpoint, DispatchMode::Inline, received);
+          }
+        }
+      }
+      // Replies are sent independently, so the next datagram can be read while
+      // earlier ones are still being handled or sent.
+      startReceive();
+    }
 
-        _socket.async_send_to(boost::asio::buffer(*message), _remoteEndpoint,
-                              boost::bind(&HelloWorldServer::handleSend, this, message,
-                                          boost::asio::placeholders::error,
-                                          boost::asio::placeholders::bytes_transferred));
+    void offload(std::string_view request, Clock::time_point received)
+    {
+      auto submitted = _workers.trySubmit(
+          [this, request = std::string(request), remote = _remoteEndpoint, received]()
+          {
+            auto message = std::make_shared<std::string>(_handler.handle(request, remote));
+            // the socket belongs to the I/O thread, hop back onto it to send
+            boost::asio::post(_socket.get_executor(), [this, message, remote, received]()
+                              { sendReply(message, remote, DispatchMode::Offload, received); });
+          });
+      if (!submitted)
+      {
+        --_outstanding;
+        _offloadRejected.fetch_add(1, std::memory_order_relaxed);
       }
     }
 
-    void handleSend(std::shared_ptr<std::string> message,
+    void sendReply(std::shared_ptr<std::string> message, const udp::endpoint &remote, DispatchMode mode,
+                   Clock::time_point received)
+    {
+      _socket.async_send_to(boost::asio::buffer(*message), remote,
+                            boost::bind(&HelloWorldServer::handleSend, this, message, mode, received,
+                                        boost::asio::placeholders::error,
+                                        boost::asio::placeholders::bytes_transferred));
+    }
+
+    void handleSend(std::shared_ptr<std::string> message, DispatchMode mode, Clock::time_point received,
                     const boost::system::error_code &ec,
                     std::size_t bytes_transferred)
     {
-      startReceive();
+      --_outstanding;
+      auto &metrics = _metrics.local();
+      if (ec)
+      {
+        metrics.sendErrors.add();
+        return;
+      }
+      metrics.packetsOut.add();
+      metrics.bytesOut.add(bytes_transferred);
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - received);
+      metrics.receiveToSend[static_cast<std::size_t>(mode)].recordOwned(elapsed.count());
     }
 
     udp::socket _socket;
     udp::endpoint _remoteEndpoint;
     std::array<char, 1024> _recvBuffer;
+    RequestHandler &_handler;
+    WorkerPool &_workers;
+    AdmissionControl &_admission;
+    ServerMetrics &_metrics;
+    // admitted requests whose reply has not been sent yet, the depth used for shedding
+    std::size_t _outstanding = 0;
+    std::atomic<std::uint64_t> _offloadRejected{0};
+  };
+
+  enum class Backend
+  {
+    Asio,
+    Uring
   };
 
+  constexpr std::size_t kMaxWorkers = 1024;
+  constexpr std::size_t kMaxQueueCapacity = std::size_t(1) << 24;
+  constexpr double kMaxRate = 1e9;
+  constexpr std::size_t kMaxStatsInterval = 24 * 60 * 60;
+
+  struct Options
+  {
+    Backend backend = Backend::Asio;
+    unsigned short port = 1111;
+    bool zeroCopySend = false;
+    std::size_t workers = std::thread::hardware_concurrency();
+    std::size_t queueCapacity = 4096;
+    DispatchMode mode = DispatchMode::Inline;
+    bool echo = false;
+    AdmissionControl::Options admission;
+    unsigned short statsPort = 0;
+    std::chrono::seconds statsInterval{0};
+  };
+
+  // A whole number in [min, max]; anything else (negative, trailing junk,
+  // out of range) is a usage error rather than a wrapped-around huge value.
+  std::size_t parseCount(const char *text, std::string_view option, std::size_t min, std::size_t max)
+  {
+    char *end = nullptr;
+    errno = 0;
+    auto value = std::strtoull(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || text[0] == '-' || value < min || value > max)
+    {
+      throw std::invalid_argument(std::string(option) + " expects a number between " + std::to_string(min) +
+                                  " and " + std::to_string(max));
+    }
+    return static_cast<std::size_t>(value);
+  }
+
+  // A finite decimal number in [0, max], with the same strictness as parseCount.
+  double parseRate(const char *text, std::string_view option, double max)
+  {
+    char *end = nullptr;
+    errno = 0;
+    auto value = std::strtod(text, &end);
+    if (errno != 0 || end == text || *end != '\0' || !(value >= 0 && value <= max))
+    {
+      throw std::invalid_argument(std::string(option) + " expects a number between 0 and " +
+                                  std::to_string(static_cast<std::uint64_t>(max)));
+    }
+    return value;
+  }
+
+  Options parseOptions(int argc, char *argv[])
+  {
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string_view arg = argv[i];
+      if (arg == "--backend" && i + 1 < argc && (argv[i + 1] == std::string_view("asio") ||
+                                                 argv[i + 1] == std::string_view("uring")))
+      {
+        options.backend = argv[++i] == std::string_view("uring") ? Backend::Uring : Backend::Asio;
+      }
+      else if (arg == "--port" && i + 1 < argc)
+      {
+        options.port = static_cast<unsigned short>(parseCount(argv[++i], arg, 1, 65535));
+      }
+      else if (arg == "--uring-zerocopy")
+      {
+        options.zeroCopySend = true;
+      }
+      else if (arg == "--offload")
+      {
+        options.mode = DispatchMode::Offload;
+      }
+      else if (arg == "--echo")
+      {
+        options.echo = true;
+      }
+      else if (arg == "--workers" && i + 1 < argc)
+      {
+        options.workers = parseCount(argv[++i], arg, 1, kMaxWorkers);
+      }
+      else if (arg == "--queue" && i + 1 < argc)
+      {
+        options.queueCapacity = parseCount(argv[++i], arg, 1, kMaxQueueCapacity);
+      }
+      else if (arg == "--rate-limit" && i + 1 < argc)
+      {
+        options.admission.ratePerSource = parseRate(argv[++i], arg, kMaxRate);
+      }
+      else if (arg == "--burst" && i + 1 < argc)
+      {
+        options.admission.burst = parseRate(argv[++i], arg, kMaxRate);
+      }
+      else if (arg == "--shed-depth" && i + 1 < argc)
+      {
+        options.admission.shedDepth = parseCount(argv[++i], arg, 0, kMaxQueueCapacity);
+      }
+      else if (arg == "--stats-port" && i + 1 < argc)
+      {
+        options.statsPort = static_cast<unsigned short>(parseCount(argv[++i], arg, 1, 65535));
+      }
+      else if (arg == "--stats-interval" && i + 1 < argc)
+      {
+        options.statsInterval = std::chrono::seconds(parseCount(argv[++i], arg, 0, kMaxStatsInterval));
+      }
+      else
+      {
+        throw std::invalid_argument("usage: udp-server [--port PORT] [--backend asio|uring] [--uring-zerocopy]\n"
+                                    "                  [--echo] [--offload] [--workers N] [--queue N]\n"
+                                    "                  [--rate-limit PPS_PER_SOURCE] [--burst N] [--shed-depth N]\n"
+                                    "                  [--stats-port PORT] [--stats-interval SECONDS]");
+      }
+    }
+    return options;
+  }
+
+  std::string renderStats(std::uint64_t offloadRejected, const AdmissionControl &admission,
+                          const WorkerPool &workers, const ServerMetrics &metrics)
+  {
+    std::ostringstream out;
+    metrics.print(out);
+    out << "accepted " << admission.accepted() << "\n"
+        << "throttled " << admission.throttled() << "\n"
+        << "shed " << admission.shed() << "\n"
+        << "offload_rejected " << offloadRejected << "\n"
+        << "offload_queue_depth " << workers.depth() << "\n";
+    return out.str();
+  }
+
+#ifdef HAVE_IO_URING
+  // Serves with UringUdpServer until a stop signal arrives. Returns false,
+  // before anything was served, if the kernel cannot run it.
+  bool runUring(const Options &options, RequestHandler &handler, WorkerPool &workers, AdmissionControl &admission,
+                ServerMetrics &metrics, const sigset_t &stopSignals)
+  {
+    UringUdpServer::Options uringOptions;
+    uringOptions.port = options.port;
+    uringOptions.zeroCopySend = options.zeroCopySend;
+    std::unique_ptr<UringUdpServer> server;
+    try
+    {
+      server = std::make_unique<UringUdpServer>(handler, workers, admission, metrics, stopSignals, uringOptions);
+    }
+    catch (const UringUnsupported &ex)
+    {
+      std::cerr << "io_uring backend unavailable (" << ex.what() << "), using asio" << std::endl;
+      return false;
+    }
+
+    // the ring thread never runs asio, stats get a thread of their own
+    boost::asio::io_service statsService;
+    auto render = [&]() { return renderStats(server->offloadRejected(), admission, workers, metrics); };
+    StatsReporter reporter{statsService, render, options.statsPort, options.statsInterval, std::cerr};
+    auto work = boost::asio::make_work_guard(statsService);
+    std::thread statsThread([&]() { statsService.run(); });
+    auto stopStats = [&]()
+    {
+      statsService.stop();
+      statsThread.join();
+    };
+    try
+    {
+      server->run();
+    }
+    catch (const UringUnsupported &ex)
+    {
+      stopStats();
+      std::cerr << "io_uring backend unavailable (" << ex.what() << "), using asio" << std::endl;
+      return false;
+    }
+    catch (...)
+    {
+      stopStats();
+      // worker tasks may still hand replies to the server, finish them before it goes away
+      workers.stop();
+      throw;
+    }
+    stopStats();
+    // workers still hold pointers to the server, drain them before it goes away
+    workers.stop();
+    std::cerr << render();
+    return true;
+  }
+#endif
+
 } // namespace
 
-int main()
+int main(int argc, char *argv[])
 {
   try
   {
+    auto options = parseOptions(argc, argv);
+#ifdef HAVE_IO_URING
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    if (options.backend == Backend::Uring)
+    {
+      // blocked before any thread starts, so they only reach the ring's signalfd
+      pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    }
+#endif
+    HelloWorldHandler hello{options.mode};
+    EchoHandler echo{options.mode};
+    RequestHandler &handler = options.echo ? static_cast<RequestHandler &>(echo) : hello;
+    WorkerPool workers{options.workers, options.queueCapacity};
+    AdmissionControl admission{options.admission};
+    ServerMetrics metrics;
+    if (options.backend == Backend::Uring)
+    {
+#ifdef HAVE_IO_URING
+      if (runUring(options, handler, workers, admission, metrics, stopSignals))
+      {
+        return 0;
+      }
+      pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+#else
+      std::cerr << "io_uring backend not built, using asio" << std::endl;
+#endif
+    }
+
     boost::asio::io_service io_service;
-    HelloWorldServer server{io_service};
+    HelloWorldServer server{io_service, handler, workers, admission, metrics, options.port};
+    auto render = [&]() { return renderStats(server.offloadRejected(), admission, workers, metrics); };
+    StatsReporter reporter{io_service, render, options.statsPort, options.statsInterval, std::cerr};
+
+    boost::asio::signal_set signals(io_service, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code &, int) { io_service.stop(); });
+
     io_service.run();
+    // workers still hold pointers to the server, drain them before it goes away
+    workers.stop();
+    std::cerr << render();
   }
   catch (const std::exception &ex)
   {
     std::cerr << ex.what() << std::endl;
   }
   return 0;
-}
\ No newline at end of file
+}
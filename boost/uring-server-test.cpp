@@ -0,0 +1,246 @@
+#include "uring-server.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <csignal>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/time.h>
+
+// Echoes over loopback through a real ring. Skipped where the kernel cannot run
+// UringUdpServer (too old, or io_uring disabled by sysctl or seccomp).
+class UringUdpServerTest : public testing::Test
+{
+protected:
+  using udp = boost::asio::ip::udp;
+
+  void SetUp() override
+  {
+    // the server stops on SIGUSR1, sent to the ring thread; like udp-server's
+    // stop signals it is blocked before any thread (worker, ring) is started
+    sigemptyset(&_stopSignals);
+    sigaddset(&_stopSignals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &_stopSignals, nullptr);
+
+    _client.open(udp::v4());
+    timeval timeout{2, 0};
+    setsockopt(_client.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  }
+
+  void TearDown() override
+  {
+    destroy();
+    // a stop signal the ring never read must not fire once unblocked
+    timespec zero{0, 0};
+    while (sigtimedwait(&_stopSignals, nullptr, &zero) > 0)
+    {
+    }
+    pthread_sigmask(SIG_UNBLOCK, &_stopSignals, nullptr);
+  }
+
+  // Starts the server on a free port; false, with skipReason() set, if io_uring is unusable.
+  bool start(DispatchMode mode, bool run = true)
+  {
+    _handler = std::make_unique<EchoHandler>(mode);
+    if (!_workers)
+    {
+      _workers = std::make_unique<WorkerPool>(2, 64);
+    }
+    UringUdpServer::Options options;
+    options.port = 0;
+    options.ringEntries = 64;
+    options.recvBuffers = 64;
+    options.sendSlots = 64;
+    try
+    {
+      _server = std::make_unique<UringUdpServer>(*_handler, *_workers, _admission, metrics, _stopSignals, options);
+    }
+    catch (const UringUnsupported &ex)
+    {
+      _skipReason = ex.what();
+      return false;
+    }
+    if (!run)
+    {
+      return true;
+    }
+    _ring = std::thread([this]()
+                        {
+                          try
+                          {
+                            _server->run();
+                          }
+                          catch (...)
+                          {
+                            _error = std::current_exception();
+                          }
+                        });
+    return true;
+  }
+
+  // Sends one request and waits for its reply. False, with skipReason() set, if
+  // the kernel turned out not to support multishot recvmsg.
+  bool roundTrip(const std::string &request, std::string &reply)
+  {
+    auto server = udp::endpoint(boost::asio::ip::address_v4::loopback(), _server->port());
+    _client.send_to(boost::asio::buffer(request), server);
+    std::array<char, 4096> buffer;
+    udp::endpoint from;
+    boost::system::error_code ec;
+    auto length = _client.receive_from(boost::asio::buffer(buffer), from, 0, ec);
+    if (ec)
+    {
+      stop();
+      try
+      {
+        if (_error)
+        {
+          std::rethrow_exception(_error);
+        }
+      }
+      catch (const UringUnsupported &ex)
+      {
+        _skipReason = ex.what();
+        return false;
+      }
+      ADD_FAILURE() << "no reply: " << ec.message();
+      return true;
+    }
+    reply.assign(buffer.data(), length);
+    return true;
+  }
+
+  // Signals the ring thread and waits for run() to return.
+  void stop()
+  {
+    if (_ring.joinable())
+    {
+      pthread_kill(_ring.native_handle(), SIGUSR1);
+      _ring.join();
+    }
+  }
+
+  void destroy()
+  {
+    stop();
+    _server.reset();
+  }
+
+  unsigned short serverPort() const
+  {
+    return _server->port();
+  }
+
+  std::string stats()
+  {
+    std::ostringstream out;
+    metrics.print(out);
+    return out.str();
+  }
+
+  const std::string &skipReason() const
+  {
+    return _skipReason;
+  }
+
+  boost::asio::io_service io_service;
+  ServerMetrics metrics;
+
+private:
+  sigset_t _stopSignals;
+  udp::socket _client{io_service};
+  std::unique_ptr<EchoHandler> _handler;
+  std::unique_ptr<WorkerPool> _workers;
+  AdmissionControl _admission{AdmissionControl::Options{}};
+  std::unique_ptr<UringUdpServer> _server;
+  std::thread _ring;
+  std::exception_ptr _error;
+  std::string _skipReason;
+};
+
+TEST_F(UringUdpServerTest, EchoesInline)
+{
+  if (!start(DispatchMode::Inline))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  for (const std::string request : {"hello", "", "world"})
+  {
+    std::string reply;
+    if (!roundTrip(request, reply))
+    {
+      GTEST_SKIP() << skipReason();
+    }
+    EXPECT_EQ(reply, request);
+  }
+  stop();
+  EXPECT_NE(stats().find("packets_out 3\n"), std::string::npos) << stats();
+  EXPECT_NE(stats().find("latency_inline n=3 "), std::string::npos) << stats();
+}
+
+TEST_F(UringUdpServerTest, EchoesOffloaded)
+{
+  if (!start(DispatchMode::Offload))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  std::string reply;
+  if (!roundTrip("offloaded", reply))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  EXPECT_EQ(reply, "offloaded");
+  stop();
+  EXPECT_NE(stats().find("latency_offload n=1 "), std::string::npos) << stats();
+}
+
+TEST_F(UringUdpServerTest, OversizedRequestIsTruncated)
+{
+  if (!start(DispatchMode::Inline))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  std::string request(3000, 'x');
+  for (std::size_t i = 0; i < request.size(); ++i)
+  {
+    request[i] = static_cast<char>('a' + i % 26);
+  }
+  std::string reply;
+  if (!roundTrip(request, reply))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  // the same 1024 byte limit as the asio backend's receive buffer
+  EXPECT_EQ(reply, request.substr(0, 1024));
+  stop();
+  EXPECT_NE(stats().find("truncated 1\n"), std::string::npos) << stats();
+}
+
+TEST_F(UringUdpServerTest, DestructionReleasesThePort)
+{
+  if (!start(DispatchMode::Offload))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  std::string reply;
+  if (!roundTrip("warm up", reply))
+  {
+    GTEST_SKIP() << skipReason();
+  }
+  auto port = serverPort();
+  // cancels the multishot receive and the polls, then frees buffers and socket
+  destroy();
+
+  udp::socket rebound(io_service);
+  rebound.open(udp::v4());
+  boost::system::error_code ec;
+  rebound.bind(udp::endpoint(udp::v4(), port), ec);
+  EXPECT_FALSE(ec) << ec.message();
+  rebound.close();
+
+  // a server that never ran has nothing armed; destroying it must not wait for anything
+  ASSERT_TRUE(start(DispatchMode::Inline, false));
+  destroy();
+}
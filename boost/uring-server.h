@@ -0,0 +1,769 @@
+#ifndef URINGSERVER_H
+#define URINGSERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <boost/asio/ip/udp.hpp>
+#include "../lockfree/lockfree-queue.h"
+#include "../lockfree/pow2.h"
+#include "rate-limiter.h"
+#include "request-handler.h"
+#include "server-metrics.h"
+#include "worker-pool.h"
+
+// The kernel lacks something the io_uring backend needs (io_uring itself,
+// provided buffer rings, multishot recvmsg); callers fall back to asio.
+class UringUnsupported : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Thin wrapper over the raw io_uring system calls and shared rings, so the
+// backend builds without liburing. Single-threaded: one thread prepares SQEs,
+// submits and reaps completions.
+class UringRing
+{
+public:
+  explicit UringRing(unsigned entries)
+  {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    // multishot receives can post many completions per submission
+    params.cq_entries = entries * 4;
+    _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd < 0 && errno == EINVAL)
+    {
+      // COOP_TASKRUN is 5.19+, only a hint
+      params = io_uring_params{};
+      params.flags = IORING_SETUP_CQSIZE;
+      params.cq_entries = entries * 4;
+      _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    }
+    if (_fd < 0)
+    {
+      throw UringUnsupported(std::string("io_uring_setup: ") + std::strerror(errno));
+    }
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+      _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+    }
+    _sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+    _cqRing = singleMmap ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes = static_cast<io_uring_sqe *>(map(_sqesSize, IORING_OFF_SQES));
+
+    auto *sq = static_cast<char *>(_sqRing);
+    _sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    _sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    // SQE i always sits in slot i, so the indirection array is set up once
+    auto *array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < _sqEntries; ++i)
+    {
+      array[i] = i;
+    }
+    _sqeTail = *_sqTail;
+
+    auto *cq = static_cast<char *>(_cqRing);
+    _cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  }
+
+  UringRing(const UringRing &) = delete;
+  UringRing &operator=(const UringRing &) = delete;
+
+  ~UringRing()
+  {
+    if (_sqes != nullptr)
+    {
+      munmap(_sqes, _sqesSize);
+    }
+    if (_cqRing != nullptr && _cqRing != _sqRing)
+    {
+      munmap(_cqRing, _cqRingSize);
+    }
+    if (_sqRing != nullptr)
+    {
+      munmap(_sqRing, _sqRingSize);
+    }
+    if (_fd >= 0)
+    {
+      close(_fd);
+    }
+  }
+
+  // A zeroed SQE, or nullptr when the submission queue is full.
+  io_uring_sqe *getSqe()
+  {
+    if (_sqeTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+    {
+      return nullptr;
+    }
+    auto *sqe = &_sqes[_sqeTail & _sqMask];
+    ++_sqeTail;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  // Hands every prepared SQE to the kernel in one system call and optionally
+  // waits for completions. Returns false if interrupted by a signal.
+  bool submit(unsigned waitFor)
+  {
+    __atomic_store_n(_sqTail, _sqeTail, __ATOMIC_RELEASE);
+    unsigned pending = _sqeTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (pending == 0 && waitFor == 0)
+    {
+      return true;
+    }
+    auto ret = syscall(__NR_io_uring_enter, _fd, pending, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0,
+                       nullptr, 0);
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+      {
+        return false;
+      }
+      // EAGAIN/EBUSY: the completion queue is backed up, reaping it makes room
+      if (errno != EAGAIN && errno != EBUSY)
+      {
+        throw std::system_error(errno, std::system_category(), "io_uring_enter");
+      }
+    }
+    return true;
+  }
+
+  // Calls onCompletion for every CQE available right now.
+  template <typename OnCompletion>
+  void reap(OnCompletion &&onCompletion)
+  {
+    unsigned head = *_cqHead;
+    unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+      try
+      {
+        onCompletion(_cqes[head & _cqMask]);
+      }
+      catch (...)
+      {
+        // consume the failing completion, so a later reap does not see it again
+        __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+        throw;
+      }
+    }
+    __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+  }
+
+  void unregisterResource(unsigned opcode, void *arg, unsigned count)
+  {
+    syscall(__NR_io_uring_register, _fd, opcode, arg, count);
+  }
+
+  void registerResource(unsigned opcode, void *arg, unsigned count, const char *what)
+  {
+    if (syscall(__NR_io_uring_register, _fd, opcode, arg, count) < 0)
+    {
+      if (errno == EINVAL || errno == EOPNOTSUPP)
+      {
+        throw UringUnsupported(std::string(what) + ": " + std::strerror(errno));
+      }
+      throw std::system_error(errno, std::system_category(), what);
+    }
+  }
+
+private:
+  void *map(std::size_t size, off_t offset)
+  {
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, offset);
+    if (memory == MAP_FAILED)
+    {
+      throw std::system_error(errno, std::system_category(), "mmap io_uring");
+    }
+    return memory;
+  }
+
+  int _fd = -1;
+  void *_sqRing = nullptr;
+  void *_cqRing = nullptr;
+  io_uring_sqe *_sqes = nullptr;
+  std::size_t _sqRingSize = 0;
+  std::size_t _cqRingSize = 0;
+  std::size_t _sqesSize = 0;
+  unsigned *_sqHead = nullptr;
+  unsigned *_sqTail = nullptr;
+  unsigned _sqMask = 0;
+  unsigned _sqEntries = 0;
+  unsigned _sqeTail = 0;
+  unsigned *_cqHead = nullptr;
+  unsigned *_cqTail = nullptr;
+  unsigned _cqMask = 0;
+  io_uring_cqe *_cqes = nullptr;
+};
+
+// HelloWorldServer's request path on io_uring instead of the asio reactor:
+//
+//  - one multishot recvmsg keeps receiving into a provided buffer ring, so a
+//    datagram costs no system call and no re-arm
+//  - replies are copied into a preallocated slab of send slots and sent with
+//    sendmsg, or with zero-copy sends once the slab is registered as a fixed
+//    buffer (Options::zeroCopySend)
+//  - every SQE prepared while handling a batch of completions goes out with
+//    the single io_uring_enter that also waits for the next batch
+//
+// Offloaded requests come back from the WorkerPool through a lock-free queue and
+// an eventfd polled by the ring. Stops when one of the given signals arrives
+// on its signalfd, so they must be blocked in every thread of the process.
+class UringUdpServer
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options
+  {
+    unsigned short port = 1111;
+    unsigned ringEntries = 1024;
+    unsigned recvBuffers = 4096;   // rounded up to a power of two, at most kMaxRecvBuffers
+    unsigned sendSlots = 4096;
+    bool zeroCopySend = false;     // IORING_OP_SEND_ZC from the registered slab
+  };
+
+  UringUdpServer(RequestHandler &handler, WorkerPool &workers, AdmissionControl &admission, ServerMetrics &metrics,
+                 const sigset_t &stopSignals, const Options &options)
+      : _handler(handler), _workers(workers), _admission(admission), _metrics(metrics), _options(options),
+        _replies(workers.capacity()), _ring(options.ringEntries)
+  {
+    try
+    {
+      openSocket();
+      setupRecvBuffers();
+      setupSendSlots();
+
+      _wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      _signalFd = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+      if (_wakeupFd < 0 || _signalFd < 0)
+      {
+        throw std::system_error(errno, std::system_category(), "eventfd/signalfd");
+      }
+    }
+    catch (...)
+    {
+      // nothing was submitted yet; the port must be free for the asio fallback
+      release();
+      throw;
+    }
+  }
+
+  UringUdpServer(const UringUdpServer &) = delete;
+  UringUdpServer &operator=(const UringUdpServer &) = delete;
+
+  ~UringUdpServer()
+  {
+    // The kernel may still write into receive buffers or read send slots until
+    // every request has completed, so none of them is released before that.
+    cancelAll();
+    release();
+  }
+
+  // Runs until a stop signal arrives. Throws UringUnsupported if the kernel
+  // rejects multishot recvmsg before the first datagram is served.
+  void run()
+  {
+    armReceive();
+    armPoll(_wakeupFd, kWakeup);
+    armPoll(_signalFd, kSignal);
+    while (!_stopping)
+    {
+      _ring.submit(1);
+      _ring.reap([this](const io_uring_cqe &cqe) { complete(cqe); });
+      // buffers recycled while handling this batch become visible to the kernel at once
+      __atomic_store_n(_bufRingTail, _bufTail, __ATOMIC_RELEASE);
+    }
+  }
+
+  std::uint64_t offloadRejected() const
+  {
+    return _offloadRejected.load(std::memory_order_relaxed);
+  }
+
+  // The bound port, i.e. the one the kernel picked for Options::port 0.
+  unsigned short port() const
+  {
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    if (getsockname(_socket, reinterpret_cast<sockaddr *>(&address), &length) < 0)
+    {
+      throw std::system_error(errno, std::system_category(), "getsockname");
+    }
+    return ntohs(address.sin_port);
+  }
+
+private:
+  // user_data layout: operation in the top byte, send slot in the rest
+  static constexpr std::uint64_t kReceive = 1ull << 56;
+  static constexpr std::uint64_t kSend = 2ull << 56;
+  static constexpr std::uint64_t kWakeup = 3ull << 56;
+  static constexpr std::uint64_t kSignal = 4ull << 56;
+  static constexpr std::uint64_t kCancel = 5ull << 56;
+  static constexpr std::uint64_t kOperationMask = 0xffull << 56;
+  static constexpr std::uint16_t kBufferGroup = 0;
+  // same limit as HelloWorldServer::_recvBuffer
+  static constexpr std::size_t kMaxPayload = 1024;
+  static constexpr std::size_t kRecvBufferSize = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + kMaxPayload;
+  static constexpr std::size_t kSendSlotSize = 2048;
+  // the kernel caps a provided buffer ring at 32768 entries (bid is 16 bits)
+  static constexpr std::size_t kMaxRecvBuffers = 32768;
+
+  struct SendSlot
+  {
+    sockaddr_in remote;
+    iovec iov;
+    msghdr message;
+    std::string overflow;  // replies too large for the slab
+    DispatchMode mode;
+    Clock::time_point received;
+  };
+
+  struct OffloadedReply
+  {
+    std::string message;
+    sockaddr_in remote;
+    Clock::time_point received;
+  };
+
+  void openSocket()
+  {
+    _socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_socket < 0)
+    {
+      throw std::system_error(errno, std::system_category(), "socket");
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_options.port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+    {
+      throw std::system_error(errno, std::system_category(), "bind");
+    }
+  }
+
+  void setupRecvBuffers()
+  {
+    auto entries = static_cast<unsigned>(round_up_pow2(_options.recvBuffers, 1, kMaxRecvBuffers));
+    _bufMask = entries - 1;
+    _recvBuffers.resize(static_cast<std::size_t>(entries) * kRecvBufferSize);
+
+    _bufRingSize = entries * sizeof(io_uring_buf);
+    void *memory = mmap(nullptr, _bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      throw std::system_error(errno, std::system_category(), "mmap buffer ring");
+    }
+    // Addressed as a plain array: in C++ the uapi io_uring_buf_ring puts bufs at
+    // offset 8 (its flex-array wrapper has an empty struct of size 1). The tail
+    // overlays bufs[0].resv.
+    _bufRing = static_cast<io_uring_buf *>(memory);
+    _bufRingTail = &_bufRing[0].resv;
+
+    io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<std::uint64_t>(_bufRing);
+    registration.ring_entries = entries;
+    registration.bgid = kBufferGroup;
+    _ring.registerResource(IORING_REGISTER_PBUF_RING, &registration, 1, "provided buffer ring");
+
+    for (unsigned bid = 0; bid < entries; ++bid)
+    {
+      recycle(static_cast<std::uint16_t>(bid));
+    }
+    __atomic_store_n(_bufRingTail, _bufTail, __ATOMIC_RELEASE);
+
+    _recvTemplate.msg_namelen = sizeof(sockaddr_in);
+  }
+
+  void setupSendSlots()
+  {
+    _sendSlots.resize(_options.sendSlots);
+    _sendSlab.resize(static_cast<std::size_t>(_options.sendSlots) * kSendSlotSize);
+    _freeSlots.reserve(_options.sendSlots);
+    for (unsigned i = _options.sendSlots; i > 0; --i)
+    {
+      _freeSlots.push_back(i - 1);
+    }
+    if (_options.zeroCopySend)
+    {
+      // registered once, so zero-copy sends skip pinning the pages per request
+      iovec slab{_sendSlab.data(), _sendSlab.size()};
+      _ring.registerResource(IORING_REGISTER_BUFFERS, &slab, 1, "registered send buffers");
+    }
+  }
+
+  io_uring_sqe *nextSqe()
+  {
+    auto *sqe = _ring.getSqe();
+    if (sqe == nullptr)
+    {
+      // submission queue full: flush what we have without waiting
+      _ring.submit(0);
+      sqe = _ring.getSqe();
+      if (sqe == nullptr)
+      {
+        throw std::runtime_error("io_uring submission queue stuck");
+      }
+    }
+    return sqe;
+  }
+
+  void armReceive()
+  {
+    auto *sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = _socket;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&_recvTemplate);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = kReceive;
+    ++_armed;
+  }
+
+  void armPoll(int fd, std::uint64_t operation)
+  {
+    auto *sqe = nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = operation;
+    ++_armed;
+  }
+
+  void release()
+  {
+    if (_bufRing != nullptr)
+    {
+      io_uring_buf_reg registration{};
+      registration.bgid = kBufferGroup;
+      _ring.unregisterResource(IORING_UNREGISTER_PBUF_RING, &registration, 1);
+      munmap(_bufRing, _bufRingSize);
+      _bufRing = nullptr;
+    }
+    for (int *fd : {&_socket, &_wakeupFd, &_signalFd})
+    {
+      if (*fd >= 0)
+      {
+        close(*fd);
+        *fd = -1;
+      }
+    }
+  }
+
+  // Cancels the multishot requests and waits until they and every send in
+  // flight have posted their final completion.
+  void cancelAll()
+  {
+    _stopping = true;
+    if (_armed > 0)
+    {
+      auto *sqe = nextSqe();
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      sqe->user_data = kCancel;
+    }
+    while (_armed > 0 || _freeSlots.size() < _sendSlots.size())
+    {
+      _ring.submit(1);
+      _ring.reap([this](const io_uring_cqe &cqe) { complete(cqe); });
+    }
+  }
+
+  void recycle(std::uint16_t bid)
+  {
+    auto &buffer = _bufRing[_bufTail & _bufMask];
+    buffer.addr = reinterpret_cast<std::uint64_t>(&_recvBuffers[static_cast<std::size_t>(bid) * kRecvBufferSize]);
+    buffer.len = kRecvBufferSize;
+    buffer.bid = bid;
+    ++_bufTail;
+  }
+
+  void complete(const io_uring_cqe &cqe)
+  {
+    auto operation = cqe.user_data & kOperationMask;
+    // a multishot request is done once a completion comes without F_MORE
+    bool ended = operation != kSend && operation != kCancel && !(cqe.flags & IORING_CQE_F_MORE);
+    if (ended)
+    {
+      --_armed;
+    }
+    switch (operation)
+    {
+      case kReceive:
+        completeReceive(cqe);
+        if (ended && !_stopping)
+        {
+          // the kernel ended the multishot (buffers ran out or an error), start a new one
+          armReceive();
+        }
+        break;
+      case kSend:
+        completeSend(cqe);
+        break;
+      case kWakeup:
+        if (cqe.res >= 0)
+        {
+          drainReplies();
+        }
+        if (ended && !_stopping)
+        {
+          armPoll(_wakeupFd, kWakeup);
+        }
+        break;
+      case kSignal:
+        _stopping = true;
+        break;
+      case kCancel:
+        break;
+    }
+  }
+
+  void completeReceive(const io_uring_cqe &cqe)
+  {
+    auto &metrics = _metrics.local();
+    if (cqe.res < 0)
+    {
+      if (cqe.res == -EINVAL && !_received && !_stopping)
+      {
+        throw UringUnsupported("multishot recvmsg: " + std::string(std::strerror(EINVAL)));
+      }
+      // -ENOBUFS: every provided buffer is in use; they are recycled as this batch is handled
+      if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED)
+      {
+        metrics.receiveErrors.add();
+      }
+    }
+    else if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+      _received = true;
+      auto bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      const char *buffer = &_recvBuffers[static_cast<std::size_t>(bid) * kRecvBufferSize];
+      io_uring_recvmsg_out out;
+      std::memcpy(&out, buffer, sizeof(out));
+      sockaddr_in remote;
+      std::memcpy(&remote, buffer + sizeof(out), sizeof(remote));
+      const char *payload = buffer + sizeof(out) + _recvTemplate.msg_namelen + _recvTemplate.msg_controllen;
+      auto length = static_cast<std::size_t>(cqe.res) - (payload - buffer);
+
+      metrics.packetsIn.add();
+      metrics.bytesIn.add(length);
+      if (out.flags & MSG_TRUNC)
+      {
+        metrics.truncated.add();
+      }
+      handleRequest(std::string_view(payload, length), remote);
+      recycle(bid);
+    }
+  }
+
+  void handleRequest(std::string_view request, const sockaddr_in &remote)
+  {
+    auto received = Clock::now();
+    boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::address_v4(ntohl(remote.sin_addr.s_addr)),
+                                            ntohs(remote.sin_port));
+    if (_admission.admit(endpoint, _outstanding, received) != Admission::Accepted)
+    {
+      return;
+    }
+    ++_outstanding;
+    if (_handler.dispatchMode(request) == DispatchMode::Offload)
+    {
+      offload(request, endpoint, remote, received);
+      return;
+    }
+    auto reply = _handler.handle(request, endpoint);
+    send(reply, remote, DispatchMode::Inline, received);
+  }
+
+  void offload(std::string_view request, const boost::asio::ip::udp::endpoint &endpoint, const sockaddr_in &remote,
+               Clock::time_point received)
+  {
+    auto submitted = _workers.trySubmit(
+        [this, request = std::string(request), endpoint, remote, received]()
+        {
+          if (!_replies.push(OffloadedReply{_handler.handle(request, endpoint), remote, received}))
+          {
+            _offloadRejected.fetch_add(1, std::memory_order_relaxed);
+            _lostReplies.fetch_add(1, std::memory_order_relaxed);
+          }
+          // one eventfd write per burst of replies is enough to wake the ring
+          if (!_wakeupPending.exchange(true))
+          {
+            std::uint64_t one = 1;
+            (void) !write(_wakeupFd, &one, sizeof(one));
+          }
+        });
+    if (!submitted)
+    {
+      --_outstanding;
+      _offloadRejected.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void drainReplies()
+  {
+    std::uint64_t value;
+    (void) !read(_wakeupFd, &value, sizeof(value));
+    _wakeupPending.store(false);
+    while (auto reply = _replies.pop())
+    {
+      send(reply->message, reply->remote, DispatchMode::Offload, reply->received);
+    }
+    _outstanding -= _lostReplies.exchange(0);
+  }
+
+  void send(const std::string &reply, const sockaddr_in &remote, DispatchMode mode, Clock::time_point received)
+  {
+    if (_freeSlots.empty())
+    {
+      // more replies in flight than slots: drop like a full socket buffer would
+      --_outstanding;
+      _metrics.local().sendErrors.add();
+      return;
+    }
+    auto index = _freeSlots.back();
+    _freeSlots.pop_back();
+    auto &slot = _sendSlots[index];
+    slot.remote = remote;
+    slot.mode = mode;
+    slot.received = received;
+
+    char *data = &_sendSlab[static_cast<std::size_t>(index) * kSendSlotSize];
+    bool inSlab = reply.size() <= kSendSlotSize;
+    if (inSlab)
+    {
+      std::memcpy(data, reply.data(), reply.size());
+    }
+    else
+    {
+      slot.overflow = reply;
+      data = &slot.overflow[0];
+    }
+
+    auto *sqe = nextSqe();
+    sqe->fd = _socket;
+    sqe->user_data = kSend | index;
+    if (_options.zeroCopySend && inSlab)
+    {
+      sqe->opcode = IORING_OP_SEND_ZC;
+      sqe->addr = reinterpret_cast<std::uint64_t>(data);
+      sqe->len = static_cast<std::uint32_t>(reply.size());
+      sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+      sqe->buf_index = 0;
+      sqe->addr2 = reinterpret_cast<std::uint64_t>(&slot.remote);
+      sqe->addr_len = sizeof(slot.remote);
+      return;
+    }
+    slot.iov = iovec{data, reply.size()};
+    slot.message = msghdr{};
+    slot.message.msg_name = &slot.remote;
+    slot.message.msg_namelen = sizeof(slot.remote);
+    slot.message.msg_iov = &slot.iov;
+    slot.message.msg_iovlen = 1;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&slot.message);
+    sqe->len = 1;
+  }
+
+  void completeSend(const io_uring_cqe &cqe)
+  {
+    auto index = static_cast<unsigned>(cqe.user_data & ~kOperationMask);
+    auto &slot = _sendSlots[index];
+    if (cqe.flags & IORING_CQE_F_NOTIF)
+    {
+      // zero-copy: the kernel is done with the slab, the slot can be reused
+      _freeSlots.push_back(index);
+      return;
+    }
+
+    --_outstanding;
+    auto &metrics = _metrics.local();
+    if (cqe.res < 0)
+    {
+      metrics.sendErrors.add();
+    }
+    else
+    {
+      metrics.packetsOut.add();
+      metrics.bytesOut.add(static_cast<std::uint64_t>(cqe.res));
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - slot.received);
+      metrics.receiveToSend[static_cast<std::size_t>(slot.mode)].recordOwned(elapsed.count());
+    }
+    slot.overflow.clear();
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+      _freeSlots.push_back(index);
+    }
+  }
+
+  RequestHandler &_handler;
+  WorkerPool &_workers;
+  AdmissionControl &_admission;
+  ServerMetrics &_metrics;
+  Options _options;
+  int _socket = -1;
+  int _wakeupFd = -1;
+  int _signalFd = -1;
+  bool _stopping = false;
+  bool _received = false;
+
+  io_uring_buf *_bufRing = nullptr;
+  std::uint16_t *_bufRingTail = nullptr;
+  std::size_t _bufRingSize = 0;
+  unsigned _bufMask = 0;
+  std::uint16_t _bufTail = 0;
+  std::vector<char> _recvBuffers;
+  msghdr _recvTemplate{};
+
+  std::vector<SendSlot> _sendSlots;
+  std::vector<char> _sendSlab;
+  std::vector<unsigned> _freeSlots;
+
+  // admitted requests whose reply has not been sent yet, the depth used for shedding
+  std::size_t _outstanding = 0;
+  LockfreeQueue<OffloadedReply> _replies;
+  std::atomic<bool> _wakeupPending{false};
+  std::atomic<std::size_t> _lostReplies{0};
+  std::atomic<std::uint64_t> _offloadRejected{0};
+  // multishot requests (receive, polls) the kernel still holds
+  unsigned _armed = 0;
+  // last, so it is closed before any memory the kernel might still touch is freed
+  UringRing _ring;
+};
+
+#endif
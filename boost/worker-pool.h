@@ -0,0 +1,137 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../lockfree/lockfree-queue.h"
+
+// Fixed set of threads draining a bounded lock-free queue. Submitting never
+// takes a lock unless a worker is parked; idle workers spin briefly before
+// parking on a condition variable so a busy pool stays syscall-free.
+class WorkerPool
+{
+public:
+  using Task = std::function<void()>;
+
+  WorkerPool(std::size_t threads, std::size_t queueCapacity) : _queue(queueCapacity)
+  {
+    if (threads == 0)
+    {
+      threads = 1;
+    }
+    _workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+      _workers.emplace_back(&WorkerPool::run, this);
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool()
+  {
+    stop();
+  }
+
+  // Returns false when the queue is full; the caller decides whether to drop or
+  // run the task itself.
+  bool trySubmit(Task task)
+  {
+    if (!_queue.push(std::move(task)))
+    {
+      return false;
+    }
+    // pairs with the fence in park(): either the worker sees the task or we see the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed) > 0)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _wakeup.notify_one();
+    }
+    return true;
+  }
+
+  // Runs whatever is already queued, then joins the workers.
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_stopping)
+      {
+        return;
+      }
+      _stopping = true;
+    }
+    _wakeup.notify_all();
+    for (auto &worker : _workers)
+    {
+      if (worker.joinable())
+      {
+        worker.join();
+      }
+    }
+  }
+
+  std::size_t depth() const
+  {
+    return _queue.size();
+  }
+
+  std::size_t capacity() const
+  {
+    return _queue.capacity();
+  }
+
+private:
+  static constexpr int kSpinsBeforePark = 64;
+
+  void run()
+  {
+    int idle = 0;
+    while (true)
+    {
+      if (auto task = _queue.pop())
+      {
+        idle = 0;
+        (*task)();
+        continue;
+      }
+      if (++idle < kSpinsBeforePark)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      idle = 0;
+      if (!park())
+      {
+        return;
+      }
+    }
+  }
+
+  // Returns false once the pool is stopping and the queue has been drained.
+  bool park()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _wakeup.wait(lock, [this] { return !_queue.empty() || _stopping; });
+    _sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return !(_stopping && _queue.empty());
+  }
+
+  LockfreeQueue<Task> _queue;
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wakeup;
+  std::atomic<int> _sleepers{0};
+  bool _stopping = false;
+};
+
+#endif
@@ -0,0 +1,50 @@
+# optimize_target(<target>) applies the project-wide LTO and PGO settings to a
+# shipped binary. Tests are left alone so they stay quick to build.
+
+include(CheckIPOSupported)
+
+if(ENABLE_LTO)
+    check_ipo_supported(RESULT LTO_SUPPORTED OUTPUT LTO_ERROR LANGUAGES CXX)
+    if(NOT LTO_SUPPORTED)
+        message(WARNING "LTO requested but not supported: ${LTO_ERROR}")
+    endif()
+endif()
+
+if(NOT PGO_MODE STREQUAL "OFF")
+    if(NOT CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        message(FATAL_ERROR "PGO_MODE=${PGO_MODE} needs GCC or Clang")
+    endif()
+    if(PGO_MODE STREQUAL "USE" AND NOT EXISTS "${PGO_PROFILE_DIR}")
+        message(FATAL_ERROR "No profiles in ${PGO_PROFILE_DIR}; build with PGO_MODE=GENERATE and run the pgo-train target first")
+    endif()
+endif()
+
+function(optimize_target target)
+    if(ENABLE_LTO AND LTO_SUPPORTED)
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION TRUE)
+    endif()
+
+    # GCC names profiles after the object file path, so GENERATE and USE must
+    # share a build directory (the pgo-* presets do)
+    if(PGO_MODE STREQUAL "GENERATE")
+        target_compile_options(${target} PRIVATE -fprofile-generate=${PGO_PROFILE_DIR})
+        if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+            # the server, client and logger all count from several threads
+            target_compile_options(${target} PRIVATE -fprofile-update=atomic)
+        endif()
+        target_link_options(${target} PRIVATE -fprofile-generate=${PGO_PROFILE_DIR})
+    elseif(PGO_MODE STREQUAL "USE")
+        if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+            # profiles from multi-threaded runs can be slightly inconsistent
+            set(pgo_flags -fprofile-use=${PGO_PROFILE_DIR} -fprofile-correction -Wno-missing-profile)
+        else()
+            # pgo-train merges the raw Clang profiles into default.profdata
+            set(pgo_flags -fprofile-use=${PGO_PROFILE_DIR}/default.profdata)
+        endif()
+        # with LTO the optimiser also runs at link time and needs the profile there
+        target_compile_options(${target} PRIVATE ${pgo_flags})
+        target_link_options(${target} PRIVATE ${pgo_flags})
+    elseif(NOT PGO_MODE STREQUAL "OFF")
+        message(FATAL_ERROR "Unknown PGO_MODE '${PGO_MODE}', expected OFF, GENERATE or USE")
+    endif()
+endfunction()
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Runs the benchmark workloads on PGO_MODE=GENERATE binaries.
+# usage: pgo-train.sh <udp-server> <udp-client> <logger-bench>
+set -e
+
+SERVER=$1
+CLIENT=$2
+LOGGER_BENCH=$3
+PORT=${PGO_PORT:-1111}
+
+# the server writes its profile on a clean shutdown, so stop it with SIGINT
+"$SERVER" --port "$PORT" --echo --workers 2 >/dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill -INT $SERVER_PID 2>/dev/null || true' EXIT
+sleep 0.5
+
+"$CLIENT" --load --port "$PORT" --concurrency 4 --window 8 --duration 5
+"$CLIENT" --load --port "$PORT" --concurrency 8 --threads 2 --rate 50000 --size 512 --duration 5
+"$CLIENT" --rpc --port "$PORT" --window 64 --duration 3
+
+kill -INT $SERVER_PID
+wait $SERVER_PID || true
+trap - EXIT
+
+# offloaded requests take a different path through the server
+"$SERVER" --port "$PORT" --echo --offload --workers 2 >/dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill -INT $SERVER_PID 2>/dev/null || true' EXIT
+sleep 0.5
+"$CLIENT" --load --port "$PORT" --concurrency 4 --window 8 --duration 3
+kill -INT $SERVER_PID
+wait $SERVER_PID || true
+trap - EXIT
+
+"$LOGGER_BENCH" 200000 4 pgo-train.log
+rm -f pgo-train.log
+
+if [ "$CXX_COMPILER_ID" != "GNU" ]; then
+    llvm-profdata merge -output="$PGO_PROFILE_DIR/default.profdata" "$PGO_PROFILE_DIR"/*.profraw
+fi
+echo "profiles written to $PGO_PROFILE_DIR"
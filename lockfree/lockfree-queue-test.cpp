@@ -0,0 +1,152 @@
+#include "lockfree-queue.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <string>
+
+class LockfreeQueueTest : public testing::Test
+{
+protected:
+  LockfreeQueue<int> queue{8};
+};
+
+TEST_F(LockfreeQueueTest, InitiallyEmpty)
+{
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.size(), 0);
+  EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST_F(LockfreeQueueTest, CapacityRoundsUpToPowerOfTwo)
+{
+  LockfreeQueue<int> odd{5};
+  EXPECT_EQ(odd.capacity(), 8);
+}
+
+TEST_F(LockfreeQueueTest, OversizedCapacityThrows)
+{
+  EXPECT_THROW(LockfreeQueue<int>{SIZE_MAX}, std::length_error);
+  EXPECT_THROW(LockfreeQueue<int>{SIZE_MAX / 2 + 2}, std::length_error);
+}
+
+TEST(RoundUpPow2Test, RoundsUpToMinimumAndLimit)
+{
+  EXPECT_EQ(round_up_pow2(0), 1);
+  EXPECT_EQ(round_up_pow2(5), 8);
+  EXPECT_EQ(round_up_pow2(8), 8);
+  EXPECT_EQ(round_up_pow2(3, 8), 8);
+  EXPECT_EQ(round_up_pow2(max_pow2), max_pow2);
+  EXPECT_THROW(round_up_pow2(max_pow2 + 1), std::length_error);
+  EXPECT_EQ(round_up_pow2(32768, 1, 32768), 32768);
+  EXPECT_THROW(round_up_pow2(32769, 1, 32768), std::length_error);
+}
+
+TEST_F(LockfreeQueueTest, FifoOrder)
+{
+  for (int i = 0; i < 5; ++i)
+  {
+    EXPECT_TRUE(queue.push(i));
+  }
+  EXPECT_EQ(queue.size(), 5);
+  for (int i = 0; i < 5; ++i)
+  {
+    auto result = queue.pop();
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result.value(), i);
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(LockfreeQueueTest, PushFailsWhenFull)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    EXPECT_TRUE(queue.push(i));
+  }
+  EXPECT_FALSE(queue.push(8));
+
+  // freeing one cell makes room again, across the wrap-around
+  EXPECT_EQ(queue.pop().value(), 0);
+  EXPECT_TRUE(queue.push(8));
+  for (int i = 1; i <= 8; ++i)
+  {
+    EXPECT_EQ(queue.pop().value(), i);
+  }
+}
+
+TEST_F(LockfreeQueueTest, MoveOnlyPayload)
+{
+  LockfreeQueue<std::unique_ptr<std::string>> owned{4};
+  EXPECT_TRUE(owned.push(std::make_unique<std::string>("hello")));
+  auto result = owned.pop();
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(**result, "hello");
+}
+
+class MultiProducerMultiConsumerTest : public testing::Test {
+protected:
+    LockfreeQueue<int> queue{1024};
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 4;
+    const int ITEMS_PER_PRODUCER = 20000;
+};
+
+TEST_F(MultiProducerMultiConsumerTest, EveryItemDeliveredOnce) {
+    std::atomic<bool> start{false};
+    std::atomic<int> total_popped{0};
+    std::set<int> unique_values;
+    std::mutex set_mutex;
+    const int total = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NUM_PRODUCERS; ++i) {
+        threads.emplace_back([&, producer_id=i]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            int base = producer_id * ITEMS_PER_PRODUCER;
+            for (int j = 0; j < ITEMS_PER_PRODUCER; ++j) {
+                // bounded queue: spin until a consumer frees a cell
+                while (!queue.push(base + j)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < NUM_CONSUMERS; ++i) {
+        threads.emplace_back([&]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            std::vector<int> local;
+            while (total_popped.load() < total) {
+                if (auto value = queue.pop()) {
+                    local.push_back(*value);
+                    total_popped.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            std::lock_guard<std::mutex> lock(set_mutex);
+            unique_values.insert(local.begin(), local.end());
+        });
+    }
+
+    start.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(total_popped.load(), total);
+    EXPECT_EQ(unique_values.size(), total) << "Items were lost or delivered twice";
+    EXPECT_TRUE(queue.empty());
+}
+
+int main()
+{
+  testing::InitGoogleTest();
+  return RUN_ALL_TESTS();
+}
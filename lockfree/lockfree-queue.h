@@ -0,0 +1,149 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "pow2.h"
+
+// Bounded multi-producer/multi-consumer queue (Vyukov). Every cell carries a
+// sequence number telling producers and consumers whose turn it is, so push and
+// pop each need a single CAS on their own position counter and never allocate.
+template <typename T>
+class LockfreeQueue
+{
+  struct cell_t
+  {
+    std::atomic<std::size_t> m_sequence;
+    T m_data;
+  };
+
+  std::unique_ptr<cell_t[]> m_buffer;
+  std::size_t m_mask;
+  // producers and consumers hammer different counters, keep them on separate cache lines
+  alignas(64) std::atomic<std::size_t> m_enqueue_pos;
+  alignas(64) std::atomic<std::size_t> m_dequeue_pos;
+
+  // largest power of two whose cell array is still addressable; sequence
+  // distances are compared as ptrdiff_t, so stay below PTRDIFF_MAX too
+  static constexpr std::size_t max_capacity()
+  {
+    std::size_t result = 2;
+    while (result <= static_cast<std::size_t>(PTRDIFF_MAX) / sizeof(cell_t) / 2)
+    {
+      result <<= 1;
+    }
+    return result;
+  }
+
+public:
+  // capacity is rounded up to the next power of two; throws std::length_error
+  // if that would not fit into memory
+  explicit LockfreeQueue(std::size_t capacity) :
+      m_buffer(new cell_t[round_up_pow2(capacity, 2, max_capacity())]),
+      m_mask(round_up_pow2(capacity, 2, max_capacity()) - 1),
+      m_enqueue_pos(0),
+      m_dequeue_pos(0)
+  {
+    for (std::size_t i = 0; i <= m_mask; ++i)
+    {
+      m_buffer[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  LockfreeQueue(LockfreeQueue const &) = delete;
+  LockfreeQueue &operator=(LockfreeQueue const &) = delete;
+
+  // returns false without consuming value when the queue is full
+  [[nodiscard]] bool push(T &&value)
+  {
+    cell_t *cell;
+    std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell = &m_buffer[pos & m_mask];
+      std::size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0)
+      {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        // the consumer has not freed this cell yet
+        return false;
+      }
+      else
+      {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->m_data = std::move(value);
+    cell->m_sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool push(T const &value)
+  {
+    T copy = value;
+    return push(std::move(copy));
+  }
+
+  std::optional<T> pop()
+  {
+    cell_t *cell;
+    std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      cell = &m_buffer[pos & m_mask];
+      std::size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0)
+      {
+        if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        // the producer has not filled this cell yet
+        return std::nullopt;
+      }
+      else
+      {
+        pos = m_dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    std::optional<T> value(std::move(cell->m_data));
+    cell->m_data = T();
+    // hand the cell to the producer one lap ahead
+    cell->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return value;
+  }
+
+  // approximate under concurrent access
+  [[nodiscard]] std::size_t size() const
+  {
+    std::size_t enqueued = m_enqueue_pos.load(std::memory_order_acquire);
+    std::size_t dequeued = m_dequeue_pos.load(std::memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  [[nodiscard]] bool empty() const
+  {
+    return size() == 0;
+  }
+
+  [[nodiscard]] std::size_t capacity() const
+  {
+    return m_mask + 1;
+  }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef POW2_H
+#define POW2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// largest power of two a size_t can hold
+constexpr std::size_t max_pow2 = SIZE_MAX / 2 + 1;
+
+// Smallest power of two that is at least value and at least minimum. Throws
+// std::length_error once that would exceed limit (a power of two) instead of
+// shifting until the result wraps round to zero.
+constexpr std::size_t round_up_pow2(std::size_t value, std::size_t minimum = 1, std::size_t limit = max_pow2)
+{
+  std::size_t result = 1;
+  while (result < value || result < minimum)
+  {
+    if (result >= limit)
+    {
+      throw std::length_error("size too large for a power-of-two table");
+    }
+    result <<= 1;
+  }
+  return result;
+}
+
+#endif
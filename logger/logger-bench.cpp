@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "logger.h"
+#include "../boost/udp-log-sink.h"
+
+// Benchmark workload: several producer threads logging a mix of the supported
+// types, plus binary records, as fast as they can. Also the training run for PGO builds.
+//
+// usage: logger-bench [messages per thread] [threads] [log file | udp://HOST:PORT]
+
+struct Order
+{
+  int id;
+  double price;
+
+  std::string toString() const
+  {
+    return "order " + std::to_string(id) + " @ " + std::to_string(price);
+  }
+};
+
+// Binary record: fixed-width fields and no padding, as logBinary requires.
+struct Fill
+{
+  std::int64_t orderId;
+  std::int64_t priceCents;
+};
+
+int main(int argc, char *argv[])
+{
+  std::size_t messages = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+  std::string file = argc > 3 ? argv[3] : "logger-bench.log";
+
+  std::shared_ptr<LogSink> sink;
+  std::shared_ptr<UdpLogSink> udpSink;
+  std::string_view udpPrefix = "udp://";
+  if (file.compare(0, udpPrefix.size(), udpPrefix) == 0)
+  {
+    auto hostPort = file.substr(udpPrefix.size());
+    auto colon = hostPort.rfind(':');
+    auto port = colon == std::string::npos ? std::string() : hostPort.substr(colon + 1);
+    char *end = nullptr;
+    auto portNumber = std::strtoul(port.c_str(), &end, 10);
+    if (port.empty() || *end != '\0' || portNumber == 0 || portNumber > 65535)
+    {
+      std::cerr << "expected udp://HOST:PORT, got " << file << std::endl;
+      return 1;
+    }
+    boost::asio::ip::udp::endpoint collector(boost::asio::ip::address::from_string(hostPort.substr(0, colon)),
+                                             static_cast<unsigned short>(portNumber));
+    sink = udpSink = std::make_shared<UdpLogSink>(collector);
+  }
+  else
+  {
+    sink = std::make_shared<FileSink>(file);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> enqueued{};
+  {
+    Logger logger(sink);
+    std::vector<std::thread> producers;
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+      producers.emplace_back([&logger, messages, t]()
+                             {
+                               for (std::size_t i = 0; i < messages; ++i)
+                               {
+                                 switch (i % 5)
+                                 {
+                                   case 0:
+                                     LOG((Order{static_cast<int>(i), 100.25}));
+                                     break;
+                                   case 1:
+                                     LOG("request served");
+                                     break;
+                                   case 2:
+                                     LOG(static_cast<int>(t * messages + i));
+                                     break;
+                                   case 3:
+                                     LOG(i * 0.5);
+                                     break;
+                                   default:
+                                     logger.logBinary(Fill{static_cast<std::int64_t>(i), 10025});
+                                     break;
+                                 }
+                               }
+                             });
+    }
+    for (auto &producer : producers)
+    {
+      producer.join();
+    }
+    enqueued = std::chrono::steady_clock::now() - start;
+    // the destructor drains the queue to disk
+  }
+  std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+
+  auto count = messages * threads;
+  std::cout << count << " messages from " << threads << " threads" << std::endl;
+  std::cout << "enqueue: " << enqueued.count() << "s (" << static_cast<std::uint64_t>(count / enqueued.count())
+            << " msg/s)" << std::endl;
+  std::cout << "written: " << total.count() << "s (" << static_cast<std::uint64_t>(count / total.count())
+            << " msg/s)" << std::endl;
+  if (udpSink)
+  {
+    std::cout << "udp: " << udpSink->batchesSent() << " batches / " << udpSink->recordsSent() << " records sent, "
+              << udpSink->batchesDropped() << " batches / " << udpSink->recordsDropped() << " records dropped, "
+              << udpSink->recordsTruncated() << " truncated" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <condition_variable>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <utility>
+#include <type_traits>
+#include <memory>
+#include <functional>
+
+// Type trait to check if a type has a toString() method
+template <typename T, typename = void>
+struct has_to_string : std::false_type
+{
+};
+
+template <typename T>
+// This specialization uses SFINAE (Substitution Failure Is Not An Error) to detect if T has a toString() method
+// std::void_t is used to create a substitution context
+// decltype(std::declval<T>().toString()) attempts to call toString() on a value of type T
+// If T has a toString() method, this specialization is selected, inheriting from std::true_type
+// If T doesn't have a toString() method, this specialization is discarded due to SFINAE, falling back to the primary template
+struct has_to_string<T, std::void_t<decltype(std::declval<T>().toString())>> : std::true_type
+{
+};
+
+// Destination for the backend thread's records. Calls come from that thread only.
+class LogSink
+{
+public:
+  virtual ~LogSink() = default;
+
+  // One formatted record: timestamp and message, without a trailing newline.
+  virtual void write(const std::string &record) = 0;
+
+  // Raw bytes from Logger::logBinary.
+  virtual void writeBinary(const std::string &bytes) = 0;
+
+  // Called whenever the backend thread has drained the queue.
+  virtual void flush() {}
+};
+
+// The text form of a binary record, for anything read by people:
+// "[binary N bytes] " followed by the bytes in hex, and a newline.
+inline void writeBinaryAsHex(std::ostream &out, std::string_view bytes)
+{
+  static const char digits[] = "0123456789abcdef";
+  out << "[binary " << bytes.size() << " bytes] ";
+  for (unsigned char byte : bytes)
+  {
+    out << digits[byte >> 4] << digits[byte & 0xf];
+  }
+  out << '\n';
+}
+
+class FileSink : public LogSink
+{
+private:
+  std::ofstream file;
+
+public:
+  FileSink(const std::string &filename) : file(filename) {}
+
+  void write(const std::string &record) override
+  {
+    file << record << '\n';
+  }
+
+  // Files are read by people, so binary records are written as hex.
+  void writeBinary(const std::string &bytes) override
+  {
+    writeBinaryAsHex(file, bytes);
+  }
+
+  void flush() override
+  {
+    file.flush();
+  }
+};
+
+class Logger
+{
+private:
+  struct LogEntry
+  {
+    std::function<std::string()> serialize;
+    bool binary;
+  };
+
+  std::shared_ptr<LogSink> sink;
+  std::queue<LogEntry> logQueue;
+  std::mutex queueMutex;
+  std::condition_variable condition;
+  std::thread loggerThread;
+  bool running;
+
+  void processLogs()
+  {
+    while (true)
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      // Wait until there are logs to process or the logger is shutting down
+      // This prevents busy-waiting and allows the thread to sleep when there's no work
+      // The lambda function is the predicate that determines when to wake up:
+      // - If the queue is not empty, there are logs to process
+      // - If running is false, the logger is shutting down and should exit
+      condition.wait(lock, [this]
+                     { return !logQueue.empty() || !running; });
+      flushQueue();
+
+      if (!running)
+      {
+        return;
+      }
+    }
+  }
+
+  void flushQueue()
+  {
+    while (!logQueue.empty())
+    {
+      LogEntry &entry = logQueue.front();
+      std::string logMessage = entry.serialize(); // Call the lambda to serialize
+      if (entry.binary)
+      {
+        sink->writeBinary(logMessage);
+      }
+      else
+      {
+        // Add the timestamp to the front of the message
+        auto now = std::chrono::system_clock::now();
+        auto now_c = std::chrono::system_clock::to_time_t(now);
+        std::stringstream timestamp;
+        timestamp << std::put_time(std::localtime(&now_c), "[%Y-%m-%d %H:%M:%S] ");
+        sink->write(timestamp.str() + logMessage);
+      }
+      logQueue.pop();
+    }
+    sink->flush();
+  }
+
+  // Helper function to convert data to string
+  template <typename T>
+  static std::string dataToString(const T &data)
+  {
+    if constexpr (has_to_string<T>::value)
+    {
+      return data.toString();
+    }
+    else if constexpr (std::is_convertible_v<T, std::string>)
+    {
+      return std::string(data);
+    }
+    else
+    {
+      std::ostringstream oss;
+      oss << data;
+      return oss.str();
+    }
+  }
+
+public:
+  Logger(const std::string &filename) : Logger(std::make_shared<FileSink>(filename)) {}
+
+  // The caller may keep its own reference to the sink, e.g. to read counters
+  // after the logger has drained and shut down.
+  Logger(std::shared_ptr<LogSink> logSink) : sink(std::move(logSink)), running(true)
+  {
+    loggerThread = std::thread(&Logger::processLogs, this);
+  }
+
+  ~Logger()
+  {
+    running = false;
+    condition.notify_one();
+    if (loggerThread.joinable())
+    {
+      loggerThread.join();
+    }
+  }
+
+  template <typename T>
+  void log(T &&data)
+  {
+    auto ptr = std::make_shared<std::decay_t<T>>(std::forward<T>(data));
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      logQueue.push({[ptr]()
+                     { return dataToString(*ptr); },
+                     false});
+    }
+    condition.notify_one();
+  }
+
+  // Logs the object representation of a value as is, for sinks and collectors
+  // that decode records themselves. Only types without padding qualify, since
+  // padding bytes are indeterminate and would ship whatever was on the stack;
+  // floating-point members are refused by the same trait.
+  template <typename T>
+  void logBinary(const T &data)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "logBinary needs a trivially copyable type");
+    static_assert(std::has_unique_object_representations_v<T>,
+                  "logBinary needs a type without padding, its padding bytes would be logged too");
+    std::string bytes(reinterpret_cast<const char *>(&data), sizeof(T));
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      logQueue.push({[bytes = std::move(bytes)]()
+                     { return bytes; },
+                     true});
+    }
+    condition.notify_one();
+  }
+};
+
+#define LOG(data) logger.log(data)
+
+#endif
@@ -1,3 +1,3 @@
-rm log.txt logger
-# c++ -std=c++20 logger.cpp -o logger 
-# ./logger
\ No newline at end of file
+rm -f log.txt
+cmake -S .. -B ../build/release -DCMAKE_BUILD_TYPE=Release && cmake --build ../build/release --target logger
+../build/release/logger/logger